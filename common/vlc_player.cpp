@@ -21,9 +21,60 @@
 
 #include "vlc_player.h"
 
+#if defined(_WIN32)
+#   include <windows.h>
+#endif
+
+static long state_seq_get(volatile long *seq)
+{
+#if defined(_WIN32)
+    return InterlockedCompareExchange(seq, 0, 0);
+#else
+    return __sync_fetch_and_add(seq, 0);
+#endif
+}
+
+static bool state_seq_cas(volatile long *seq, long old_value, long new_value)
+{
+#if defined(_WIN32)
+    return InterlockedCompareExchange(seq, new_value, old_value) == old_value;
+#else
+    return __sync_bool_compare_and_swap(seq, old_value, new_value);
+#endif
+}
+
+static void reset_state(vlc_player_state *state)
+{
+    state->time     = -1;
+    state->length   = -1;
+    state->position = -1.f;
+    state->state    = libvlc_NothingSpecial;
+    state->rate     = 1.f;
+    state->seekable = false;
+    state->pausable = false;
+}
+
+/* media player events keeping _state up to date */
+static const libvlc_event_type_t state_events[] = {
+    libvlc_MediaPlayerMediaChanged,
+    libvlc_MediaPlayerNothingSpecial,
+    libvlc_MediaPlayerOpening,
+    libvlc_MediaPlayerPlaying,
+    libvlc_MediaPlayerPaused,
+    libvlc_MediaPlayerStopped,
+    libvlc_MediaPlayerEndReached,
+    libvlc_MediaPlayerEncounteredError,
+    libvlc_MediaPlayerTimeChanged,
+    libvlc_MediaPlayerPositionChanged,
+    libvlc_MediaPlayerLengthChanged,
+    libvlc_MediaPlayerSeekableChanged,
+    libvlc_MediaPlayerPausableChanged,
+};
+
 vlc_player::vlc_player()
-    :_libvlc_instance(0), _mp(0), _ml(0), _ml_p(0)
+    :_libvlc_instance(0), _mp(0), _ml(0), _ml_p(0), _state_seq(0)
 {
+    reset_state(&_state);
 }
 
 vlc_player::~vlc_player(void)
@@ -48,6 +99,7 @@ bool vlc_player::open(libvlc_instance_t* inst)
     if( _mp && _ml && _ml_p ) {
         libvlc_media_list_player_set_media_list(_ml_p, _ml);
         libvlc_media_list_player_set_media_player(_ml_p, _mp);
+        hook_state(true);
     }
     else{
         close();
@@ -83,13 +135,114 @@ void vlc_player::close()
     }
 
     if(_mp) {
+        hook_state(false);
         libvlc_media_player_release(_mp);
         _mp = 0;
+
+        long seq = lock_state();
+        reset_state(&_state);
+        unlock_state(seq);
     }
 
     _libvlc_instance = 0;
 }
 
+void vlc_player::hook_state(bool attach)
+{
+    libvlc_event_manager_t *em = libvlc_media_player_event_manager(_mp);
+    for( unsigned i = 0; i < sizeof(state_events) / sizeof(state_events[0]); ++i ) {
+        if( attach )
+            libvlc_event_attach(em, state_events[i], state_event, this);
+        else
+            libvlc_event_detach(em, state_events[i], state_event, this);
+    }
+}
+
+void vlc_player::state_event(const libvlc_event_t *event, void *param)
+{
+    static_cast<vlc_player *>(param)->update_state(event);
+}
+
+long vlc_player::lock_state()
+{
+    long seq;
+    do
+        seq = state_seq_get(&_state_seq) & ~1L;
+    while( !state_seq_cas(&_state_seq, seq, seq + 1) );
+    return seq;
+}
+
+void vlc_player::unlock_state(long seq)
+{
+    state_seq_cas(&_state_seq, seq + 1, seq + 2);
+}
+
+void vlc_player::update_state(const libvlc_event_t *event)
+{
+    long seq = lock_state();
+    switch( event->type ) {
+    case libvlc_MediaPlayerMediaChanged:
+    case libvlc_MediaPlayerStopped:
+        // no input until the next Opening
+        _state.time     = -1;
+        _state.length   = -1;
+        _state.position = -1.f;
+        _state.seekable = false;
+        _state.pausable = false;
+        _state.state    = event->type == libvlc_MediaPlayerStopped ?
+                              libvlc_Stopped : libvlc_NothingSpecial;
+        break;
+    case libvlc_MediaPlayerNothingSpecial:
+        _state.state = libvlc_NothingSpecial;
+        break;
+    case libvlc_MediaPlayerOpening:
+        _state.state = libvlc_Opening;
+        break;
+    case libvlc_MediaPlayerPlaying:
+        _state.state = libvlc_Playing;
+        break;
+    case libvlc_MediaPlayerPaused:
+        _state.state = libvlc_Paused;
+        break;
+    case libvlc_MediaPlayerEndReached:
+        _state.state = libvlc_Ended;
+        break;
+    case libvlc_MediaPlayerEncounteredError:
+        _state.state = libvlc_Error;
+        break;
+    case libvlc_MediaPlayerTimeChanged:
+        _state.time = event->u.media_player_time_changed.new_time;
+        break;
+    case libvlc_MediaPlayerPositionChanged:
+        _state.position = event->u.media_player_position_changed.new_position;
+        break;
+    case libvlc_MediaPlayerLengthChanged:
+        _state.length = event->u.media_player_length_changed.new_length;
+        break;
+    case libvlc_MediaPlayerSeekableChanged:
+        _state.seekable = event->u.media_player_seekable_changed.new_seekable != 0;
+        break;
+    case libvlc_MediaPlayerPausableChanged:
+        _state.pausable = event->u.media_player_pausable_changed.new_pausable != 0;
+        break;
+    default:
+        break;
+    }
+    unlock_state(seq);
+}
+
+vlc_player_state vlc_player::get_cached_state() const
+{
+    volatile long *seq = const_cast<volatile long *>(&_state_seq);
+    vlc_player_state state;
+    long s;
+    do {
+        s = state_seq_get(seq);
+        state = _state;
+    } while( (s & 1) || s != state_seq_get(seq) );
+    return state;
+}
+
 int vlc_player::add_item(const char * mrl, unsigned int optc, const char **optv)
 {
     if( !is_open() )
@@ -257,7 +410,13 @@ void vlc_player::set_rate(float rate)
     if( !is_open() )
         return;
 
-    libvlc_media_player_set_rate(_mp, rate);
+    // there is no rate event, keep the cached state in step here
+    if( libvlc_media_player_set_rate(_mp, rate) != 0 )
+        return;
+
+    long seq = lock_state();
+    _state.rate = rate;
+    unlock_state(seq);
 }
 
 float vlc_player::get_fps()
@@ -292,6 +451,15 @@ void vlc_player::set_position(float p)
         return;
 
     libvlc_media_player_set_position(_mp, p);
+
+    // the next events may be long to come, a read back must see the seek
+    long seq = lock_state();
+    if( _state.seekable ) {
+        _state.position = p;
+        if( _state.length > 0 )
+            _state.time = (libvlc_time_t)(p * _state.length);
+    }
+    unlock_state(seq);
 }
 
 libvlc_time_t vlc_player::get_time()
@@ -310,6 +478,15 @@ void vlc_player::set_time(libvlc_time_t t)
         return;
 
     libvlc_media_player_set_time(_mp, t);
+
+    // as in set_position()
+    long seq = lock_state();
+    if( _state.seekable ) {
+        _state.time = t;
+        if( _state.length > 0 )
+            _state.position = (float)t / _state.length;
+    }
+    unlock_state(seq);
 }
 
 libvlc_time_t vlc_player::get_length()
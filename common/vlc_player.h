@@ -32,6 +32,18 @@ enum vlc_player_action_e
     pa_prev
 };
 
+/* playback state of the media player, as last reported by its events */
+struct vlc_player_state
+{
+    libvlc_time_t  time;     /* -1 without input */
+    libvlc_time_t  length;   /* -1 without input */
+    float          position; /* -1 without input */
+    libvlc_state_t state;
+    float          rate;
+    bool           seekable;
+    bool           pausable;
+};
+
 class vlc_player
 {
 public:
@@ -79,6 +91,9 @@ public:
 
     libvlc_time_t get_length();
 
+    // never calls into libvlc, nor waits for it
+    vlc_player_state get_cached_state() const;
+
     void set_mode(libvlc_playback_mode_t);
 
     bool is_muted();
@@ -98,12 +113,29 @@ public:
     libvlc_media_player_t* get_mp() const
         { return _mp; }
 
+    libvlc_media_list_t* get_ml() const
+        { return _ml; }
+
+    libvlc_media_list_player_t* get_mlp() const
+        { return _ml_p; }
+
 protected:
     virtual void on_player_action( vlc_player_action_e ){};
 
 private:
+    static void state_event(const libvlc_event_t *, void *);
+    void update_state(const libvlc_event_t *);
+    void hook_state(bool);
+    long lock_state();
+    void unlock_state(long seq);
+
     libvlc_instance_t *         _libvlc_instance;
     libvlc_media_player_t*      _mp;
     libvlc_media_list_t*        _ml;
     libvlc_media_list_player_t* _ml_p;
+
+    // sequence lock of _state: odd while being written, event threads
+    // may race each other and take turns
+    volatile long    _state_seq;
+    vlc_player_state _state;
 };
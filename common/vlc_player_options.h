@@ -56,7 +56,12 @@ enum vlc_player_option_e
     po_enable_fullscreen,
     po_bg_text,
     po_bg_color,
-    po_enable_branding
+    po_enable_branding,
+    po_frame_buffers,
+    po_video_chroma,
+    po_yuv_matrix,
+    po_full_range,
+    po_video_threads
 };
 
 class vlc_player_options
@@ -64,7 +69,9 @@ class vlc_player_options
 public:
     vlc_player_options()
         :_autoplay(true), _show_toolbar(true), _enable_fullscreen(true), _enable_branding(false),
-        _bg_color(/*black*/"#000000")
+        _bg_color(/*black*/"#000000"), _frame_buffers(3),
+        _video_chroma("RV32"), _yuv_matrix("auto"), _full_range(false),
+        _video_threads(0)
    {}
 
     void set_autoplay(bool ap){
@@ -111,6 +118,49 @@ public:
     bool get_enable_branding() const
     {return _enable_branding;}
 
+    //number of frame buffers used by the windowless video output
+    void set_frame_buffers(unsigned fb){
+        _frame_buffers = fb;
+        on_option_change(po_frame_buffers);
+    }
+    unsigned get_frame_buffers() const
+        {return _frame_buffers;}
+
+    //chroma requested by the windowless video output: "RV32", "I420" or
+    //"NV12", planar frames being converted to RGB by the plugin
+    void set_video_chroma(const std::string& vc){
+        _video_chroma = vc;
+        on_option_change(po_video_chroma);
+    }
+    const std::string& get_video_chroma() const {
+        return _video_chroma;
+    }
+
+    //YUV matrix of planar frames: "bt601", "bt709" or "auto" (by height)
+    void set_yuv_matrix(const std::string& ym){
+        _yuv_matrix = ym;
+        on_option_change(po_yuv_matrix);
+    }
+    const std::string& get_yuv_matrix() const {
+        return _yuv_matrix;
+    }
+
+    //planar frames use the full [0, 255] range instead of [16, 235]
+    void set_full_range(bool fr){
+        _full_range = fr;
+        on_option_change(po_full_range);
+    }
+    bool get_full_range() const
+        {return _full_range;}
+
+    //threads converting and scaling windowless frames, 0 for one per CPU
+    void set_video_threads(unsigned vt){
+        _video_threads = vt;
+        on_option_change(po_video_threads);
+    }
+    unsigned get_video_threads() const
+        {return _video_threads;}
+
     virtual void on_option_change(vlc_player_option_e ){};
 
 private:
@@ -121,6 +171,11 @@ private:
     std::string  _bg_text;
     //background color format is "#rrggbb"
     std::string  _bg_color;
+    unsigned     _frame_buffers;
+    std::string  _video_chroma;
+    std::string  _yuv_matrix;
+    bool         _full_range;
+    unsigned     _video_threads;
 };
 
 #endif //_VLC_PLAYER_OPTIONS_H_
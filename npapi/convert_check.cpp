@@ -0,0 +1,166 @@
+/*****************************************************************************
+ * convert_check.cpp: compares the YUV to RGB kernels with the C reference
+ *****************************************************************************
+ * Copyright (C) 2013 VLC Authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*
+ * Every kernel this CPU runs must be bit exact with yuv_to_rgb32_c(), for
+ * both matrices, both ranges, both layouts and both pixel orders, on
+ * widths around the SIMD block sizes, and must not write past the lines
+ * and the width it was given. Run by "make check".
+ */
+
+#include "vlcwindowless_convert.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+enum {
+    PITCH_ALIGN = 32,   /* as the plugin asks libvlc, see planar_format() */
+    CANARY = 0x5a
+};
+
+static unsigned align_pitch(unsigned pitch)
+{
+    return (pitch + PITCH_ALIGN - 1) & ~(unsigned)(PITCH_ALIGN - 1);
+}
+
+/* pseudo random, with whole lines at the extremes to hit the saturation */
+static void fill_plane(std::vector<uint8_t> &plane, unsigned pitch,
+                       unsigned lines, unsigned seed)
+{
+    srand(seed);
+    for( size_t i = 0; i < plane.size(); ++i )
+        plane[i] = rand() & 0xff;
+    if( lines > 2 ) {
+        memset(&plane[0], 0x00, pitch);
+        memset(&plane[pitch], 0xff, pitch);
+    }
+}
+
+static const char *matrix_name(yuv_matrix_e matrix)
+{
+    return matrix == yuv_matrix_bt709 ? "bt709" : "bt601";
+}
+
+static const char *layout_name(yuv_layout_e layout)
+{
+    return layout == yuv_layout_nv12 ? "nv12" : "i420";
+}
+
+/* returns the number of mismatches */
+static unsigned check_frame(const yuv_convert_t &conv, unsigned width,
+                            unsigned height, const char *what)
+{
+    unsigned chroma_width = (width + 1) / 2;
+    unsigned chroma_height = (height + 1) / 2;
+
+    std::vector<uint8_t> planes[3];
+    yuv_frame_t src;
+    src.width = width;
+    src.height = height;
+    src.pitch[0] = align_pitch(width);
+    planes[0].resize((size_t)src.pitch[0] * height);
+    if( conv.layout == yuv_layout_nv12 ) {
+        src.pitch[1] = align_pitch(chroma_width * 2);
+        src.pitch[2] = 0;
+    } else {
+        src.pitch[1] = src.pitch[2] = align_pitch(chroma_width);
+        planes[2].resize((size_t)src.pitch[2] * chroma_height);
+    }
+    planes[1].resize((size_t)src.pitch[1] * chroma_height);
+    for( unsigned i = 0; i < 3; ++i ) {
+        fill_plane(planes[i], src.pitch[i], i ? chroma_height : height,
+                   width * 131 + height * 7 + i);
+        src.plane[i] = planes[i].empty() ? NULL : &planes[i][0];
+    }
+
+    // a tight destination pitch catches writes past the width
+    unsigned dst_pitch = width * 4;
+    size_t size = (size_t)dst_pitch * height;
+    std::vector<uint8_t> ref(size, CANARY);
+    std::vector<uint8_t> out(size);
+
+    // an odd first line and a stripe ending inside the frame, as the
+    // worker threads split it
+    unsigned first = height > 2 ? 1 : 0;
+    unsigned last = height > 3 ? height - 1 : height;
+    yuv_to_rgb32_c(conv, src, &ref[0], dst_pitch, first, last);
+
+    unsigned failures = 0;
+    for( unsigned k = 1; yuv_to_rgb32_kernel_name(k); ++k ) {
+        memset(&out[0], CANARY, size);
+        yuv_to_rgb32_kernel(k, conv, src, &out[0], dst_pitch, first, last);
+        for( size_t i = 0; i < size; ++i ) {
+            if( out[i] != ref[i] ) {
+                fprintf(stderr, "%s: %s %ux%u differs at line %u pixel %u"
+                        " byte %u: %u instead of %u\n",
+                        yuv_to_rgb32_kernel_name(k), what, width, height,
+                        (unsigned)(i / dst_pitch),
+                        (unsigned)(i % dst_pitch) / 4,
+                        (unsigned)(i % 4), out[i], ref[i]);
+                ++failures;
+                break;
+            }
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    static const unsigned heights[] = { 1, 2, 5, 16 };
+    static const unsigned wide[] = { 127, 128, 129, 720, 1279, 1920 };
+
+    printf("kernels:");
+    for( unsigned k = 0; yuv_to_rgb32_kernel_name(k); ++k )
+        printf(" %s", yuv_to_rgb32_kernel_name(k));
+    printf(", yuv_to_rgb32() uses %s\n", yuv_to_rgb32_impl());
+
+    unsigned failures = 0, frames = 0;
+    for( int m = 0; m < 2; ++m )
+    for( int r = 0; r < 2; ++r )
+    for( int l = 0; l < 2; ++l )
+    for( int o = 0; o < 2; ++o )
+    {
+        yuv_matrix_e matrix = m ? yuv_matrix_bt709 : yuv_matrix_bt601;
+        yuv_layout_e layout = l ? yuv_layout_nv12 : yuv_layout_i420;
+        rgb_order_e order = o ? rgb_order_rgba : rgb_order_bgra;
+        yuv_convert_t conv;
+        yuv_convert_init(&conv, matrix, r != 0, layout, order);
+
+        char what[64];
+        snprintf(what, sizeof(what), "%s %s range %s %s", matrix_name(matrix),
+                 r ? "full" : "limited", layout_name(layout),
+                 o ? "rgba" : "bgra");
+
+        // every tail length of the 8, 16 and 32 pixel blocks
+        for( unsigned h = 0; h < sizeof(heights) / sizeof(*heights); ++h ) {
+            for( unsigned w = 1; w <= 66; ++w, ++frames )
+                failures += check_frame(conv, w, heights[h], what);
+        }
+        for( unsigned w = 0; w < sizeof(wide) / sizeof(*wide); ++w, ++frames )
+            failures += check_frame(conv, wide[w], 9, what);
+    }
+
+    printf("%u frames, %u mismatches\n", frames, failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -30,6 +30,10 @@
 #include "vlcplugin.h"
 #include "events.h"
 
+#include <cfloat>
+#include <locale>
+#include <sstream>
+
 /*****************************************************************************
  * Event Object
  *****************************************************************************/
@@ -58,7 +62,7 @@ void handle_input_event(const libvlc_event_t* event, void *param)
 void handle_changed_event(const libvlc_event_t* event, void *param)
 {
     uint32_t   npcount = 1;
-    NPVariant *npparam = (NPVariant *) NPN_MemAlloc( sizeof(NPVariant) * npcount );
+    NPVariant  npparam[1];
 
     VlcPluginBase *plugin = (VlcPluginBase*)param;
     switch( event->type )
@@ -85,94 +89,633 @@ void handle_changed_event(const libvlc_event_t* event, void *param)
             DOUBLE_TO_NPVARIANT(event->u.media_player_length_changed.new_length, npparam[0]);
             break;
         default: /* ignore all other libvlc_event_type_t */
-            NPN_MemFree( npparam );
             return;
     }
     plugin->event_callback(event, npparam, npcount);
 }
 
+void handle_media_event(const libvlc_event_t* event, void *param)
+{
+    uint32_t   npcount = 1;
+    NPVariant  npparam[1];
+
+    VlcPluginBase *plugin = (VlcPluginBase*)param;
+    switch( event->type )
+    {
+        case libvlc_MediaParsedChanged:
+            INT32_TO_NPVARIANT(event->u.media_parsed_changed.new_status, npparam[0]);
+            break;
+        case libvlc_MediaMetaChanged:
+            INT32_TO_NPVARIANT(event->u.media_meta_changed.meta_type, npparam[0]);
+            break;
+        case libvlc_MediaListItemAdded:
+            INT32_TO_NPVARIANT(event->u.media_list_item_added.index, npparam[0]);
+            break;
+        case libvlc_MediaListItemDeleted:
+            INT32_TO_NPVARIANT(event->u.media_list_item_deleted.index, npparam[0]);
+            break;
+        case libvlc_MediaListPlayerNextItemSet:
+            npcount = 0;
+            break;
+        default: /* ignore all other libvlc_event_type_t */
+            return;
+    }
+    plugin->event_callback(event, npcount ? npparam : NULL, npcount);
+}
+
 static vlcplugin_event_t vlcevents[] = {
-    { "MediaPlayerMediaChanged", libvlc_MediaPlayerMediaChanged, handle_input_event },
-    { "MediaPlayerNothingSpecial", libvlc_MediaPlayerNothingSpecial, handle_input_event },
-    { "MediaPlayerOpening", libvlc_MediaPlayerOpening, handle_input_event },
-    { "MediaPlayerBuffering", libvlc_MediaPlayerBuffering, handle_changed_event },
-    { "MediaPlayerPlaying", libvlc_MediaPlayerPlaying, handle_input_event },
-    { "MediaPlayerPaused", libvlc_MediaPlayerPaused, handle_input_event },
-    { "MediaPlayerStopped", libvlc_MediaPlayerStopped, handle_input_event },
-    { "MediaPlayerForward", libvlc_MediaPlayerForward, handle_input_event },
-    { "MediaPlayerBackward", libvlc_MediaPlayerBackward, handle_input_event },
-    { "MediaPlayerEndReached", libvlc_MediaPlayerEndReached, handle_input_event },
-    { "MediaPlayerEncounteredError", libvlc_MediaPlayerEncounteredError, handle_input_event },
-    { "MediaPlayerTimeChanged", libvlc_MediaPlayerTimeChanged, handle_changed_event },
-    { "MediaPlayerPositionChanged", libvlc_MediaPlayerPositionChanged, handle_changed_event },
-    { "MediaPlayerSeekableChanged", libvlc_MediaPlayerSeekableChanged, handle_changed_event },
-    { "MediaPlayerPausableChanged", libvlc_MediaPlayerPausableChanged, handle_changed_event },
-    { "MediaPlayerTitleChanged", libvlc_MediaPlayerTitleChanged, handle_changed_event },
-    { "MediaPlayerLengthChanged", libvlc_MediaPlayerLengthChanged, handle_changed_event },
+    { "MediaPlayerMediaChanged", libvlc_MediaPlayerMediaChanged, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerNothingSpecial", libvlc_MediaPlayerNothingSpecial, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerOpening", libvlc_MediaPlayerOpening, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerBuffering", libvlc_MediaPlayerBuffering, handle_changed_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerPlaying", libvlc_MediaPlayerPlaying, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerPaused", libvlc_MediaPlayerPaused, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerStopped", libvlc_MediaPlayerStopped, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerForward", libvlc_MediaPlayerForward, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerBackward", libvlc_MediaPlayerBackward, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerEndReached", libvlc_MediaPlayerEndReached, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerEncounteredError", libvlc_MediaPlayerEncounteredError, handle_input_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerTimeChanged", libvlc_MediaPlayerTimeChanged, handle_changed_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerPositionChanged", libvlc_MediaPlayerPositionChanged, handle_changed_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerSeekableChanged", libvlc_MediaPlayerSeekableChanged, handle_changed_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerPausableChanged", libvlc_MediaPlayerPausableChanged, handle_changed_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerTitleChanged", libvlc_MediaPlayerTitleChanged, handle_changed_event, EVENT_SOURCE_PLAYER },
+    { "MediaPlayerLengthChanged", libvlc_MediaPlayerLengthChanged, handle_changed_event, EVENT_SOURCE_PLAYER },
+    { "MediaParsedChanged", libvlc_MediaParsedChanged, handle_media_event, EVENT_SOURCE_MEDIA },
+    { "MediaMetaChanged", libvlc_MediaMetaChanged, handle_media_event, EVENT_SOURCE_MEDIA },
+    { "MediaListItemAdded", libvlc_MediaListItemAdded, handle_media_event, EVENT_SOURCE_LIST },
+    { "MediaListItemDeleted", libvlc_MediaListItemDeleted, handle_media_event, EVENT_SOURCE_LIST },
+    { "MediaListPlayerNextItemSet", libvlc_MediaListPlayerNextItemSet, handle_media_event, EVENT_SOURCE_LIST_PLAYER },
 };
 
-EventObj::EventObj() : _em(NULL), _already_in_deliver(false)
+EventObj::EventObj() : _player(NULL), _media(NULL), _userdata(NULL), _hold_all(false),
+    _attached(ARRAY_SIZE(vlcevents), false), _ltable(ARRAY_SIZE(vlcevents)),
+    _queue_tail(0), _queue_head(0), _dropped(0),
+    _coalesced(0), _latency(ARRAY_SIZE(vlcevents)), _already_in_deliver(false),
+    _deliver_skipped(false), _drain(0)
 {
-    plugin_lock_init(&lock);
+    for( size_t i = 0; i < EVENT_SOURCES; i++ )
+        _em[i] = NULL;
+    reset_latency();
+    for( size_t i = 0; i < EVENT_QUEUE_SIZE; i++ )
+        _queue[i].seq = i;
+    for( size_t i = 0; i < EVENT_COALESCED_TYPES; i++ )
+    {
+        _latest[i].seq = 0;
+        _latest[i].queued = 0;
+        VOID_TO_NPVARIANT(_latest[i].value);
+    }
 }
 
 EventObj::~EventObj()
 {
-    plugin_lock_destroy(&lock);
+    VLCEvent event;
+    while( pop(&event) )
+        free_params(event.params(), event.count());
+    for( size_t i = 0; i < _batch_listeners.size(); i++ )
+        NPN_ReleaseObject( _batch_listeners[i] );
+}
+
+/* writers may race each other, they take turns */
+void EventObj::StateSlot::store(const NPVariant &v, int64_t t)
+{
+    long s;
+    do
+        s = plugin_atomic_get(&seq) & ~1L;
+    while( !plugin_atomic_cas(&seq, s, s + 1) );
+    value = v;
+    time = t;
+    plugin_atomic_swap(&seq, s + 2);
+}
+
+NPVariant EventObj::StateSlot::load(int64_t *t)
+{
+    NPVariant v;
+    long s;
+    do
+    {
+        s = plugin_atomic_get(&seq);
+        v = value;
+        *t = time;
+    }
+    while( (s & 1) || s != plugin_atomic_get(&seq) );
+    return v;
+}
+
+/* only the latest value of these matters to the page */
+int EventObj::coalesce_index(libvlc_event_type_t type)
+{
+    switch( type )
+    {
+        case libvlc_MediaPlayerTimeChanged:
+            return 0;
+        case libvlc_MediaPlayerPositionChanged:
+            return 1;
+        case libvlc_MediaPlayerBuffering:
+            return 2;
+        default:
+            return -1;
+    }
+}
+
+/* called from any libvlc thread, never blocks */
+bool EventObj::push(const VLCEvent &event)
+{
+    unsigned long pos = plugin_atomic_get(&_queue_tail);
+    EventSlot *slot;
+    for( ;; )
+    {
+        slot = &_queue[pos & (EVENT_QUEUE_SIZE - 1)];
+        unsigned long seq = plugin_atomic_get(&slot->seq);
+        long diff = (long)(seq - pos);
+        if( diff == 0 )
+        {
+            if( plugin_atomic_cas(&_queue_tail, pos, pos + 1) )
+                break;
+            pos = plugin_atomic_get(&_queue_tail);
+        }
+        else if( diff < 0 )
+            return false; /* full */
+        else /* another producer took this slot */
+            pos = plugin_atomic_get(&_queue_tail);
+    }
+
+    slot->event = event;
+    plugin_atomic_swap(&slot->seq, pos + 1); /* publish */
+    return true;
+}
+
+/* browser thread only */
+bool EventObj::pop(VLCEvent *event)
+{
+    EventSlot *slot = &_queue[_queue_head & (EVENT_QUEUE_SIZE - 1)];
+    if( (unsigned long)plugin_atomic_get(&slot->seq) != _queue_head + 1 )
+        return false; /* empty, or the producer did not publish yet */
+
+    *event = slot->event;
+    plugin_atomic_swap(&slot->seq, _queue_head + EVENT_QUEUE_SIZE);
+    _queue_head++;
+    return true;
+}
+
+void EventObj::free_params(NPVariant *params, uint32_t count)
+{
+    if( !params )
+        return;
+
+    for( uint32_t n = 0; n < count; n++ )
+    {
+        if( NPVARIANT_IS_STRING(params[n]) )
+        {
+            NPN_MemFree( (void*) NPVARIANT_TO_STRING(params[n]).UTF8Characters );
+        }
+        else if( NPVARIANT_IS_OBJECT(params[n]) )
+        {
+            NPN_ReleaseObject( NPVARIANT_TO_OBJECT(params[n]) );
+            NPN_MemFree( (void*)NPVARIANT_TO_OBJECT(params[n]) );
+        }
+    }
+}
+
+bool EventObj::Listener::accept(const NPVariant *params, uint32_t count,
+                                int64_t now, unsigned drain)
+{
+    if( ready(params, count, now) )
+    {
+        _trailing = false;
+        return true;
+    }
+
+    _trailing = true;
+    _trailing_drain = drain;
+    _trailing_count = count;
+    for( uint32_t i = 0; i < count; i++ )
+        _trailing_params[i] = params[i];
+    return false;
+}
+
+bool EventObj::Listener::trailing(NPVariant *params, uint32_t *count,
+                                  int64_t now, unsigned drain)
+{
+    /* a newer event of this drain may still come, or be accepted */
+    if( !_trailing || _trailing_drain == drain )
+        return false;
+    if( _min_interval && now - _last_time < _min_interval )
+        return false;
+
+    _trailing = false;
+    *count = _trailing_count;
+    for( uint32_t i = 0; i < _trailing_count; i++ )
+        params[i] = _trailing_params[i];
+    if( _trailing_count > 0 && NPVARIANT_IS_DOUBLE(params[0]) )
+        _last_value = NPVARIANT_TO_DOUBLE(params[0]);
+    else if( _trailing_count > 0 && NPVARIANT_IS_INT32(params[0]) )
+        _last_value = NPVARIANT_TO_INT32(params[0]);
+    _last_time = now;
+    return true;
+}
+
+bool EventObj::Listener::ready(const NPVariant *params, uint32_t count,
+                               int64_t now)
+{
+    if( _min_interval && _called && now - _last_time < _min_interval )
+        return false;
+
+    if( _min_delta > 0 && count > 0 &&
+        ( NPVARIANT_IS_DOUBLE(params[0]) || NPVARIANT_IS_INT32(params[0]) ) )
+    {
+        double value = NPVARIANT_IS_DOUBLE(params[0]) ?
+                       NPVARIANT_TO_DOUBLE(params[0]) :
+                       NPVARIANT_TO_INT32(params[0]);
+        double delta = value > _last_value ? value - _last_value
+                                           : _last_value - value;
+        if( _called && delta < _min_delta )
+            return false;
+        _last_value = value;
+    }
+
+    _last_time = now;
+    _called = true;
+    return true;
+}
+
+/* a new empty array or object of the page, from a fixed literal */
+static NPObject *new_script_object(NPP browser, NPObject *window,
+                                   const char *literal)
+{
+    NPString script;
+    script.UTF8Characters = literal;
+    script.UTF8Length = strlen(literal);
+
+    NPVariant created;
+    if( !NPN_Evaluate(browser, window, &script, &created) )
+        return NULL;
+    if( !NPVARIANT_IS_OBJECT(created) )
+    {
+        NPN_ReleaseVariantValue(&created);
+        return NULL;
+    }
+    return NPVARIANT_TO_OBJECT(created);
+}
+
+/* script tokens for any double: no locale decimal separator, and the
+ * non finite values are spelled the javascript way */
+static void append_number(std::ostream &s, double value)
+{
+    if( value != value )
+        s << "NaN";
+    else if( value > DBL_MAX )
+        s << "Infinity";
+    else if( value < -DBL_MAX )
+        s << "-Infinity";
+    else
+        s << value;
+}
+
+static void append_value(std::ostream &s, const NPVariant *params, uint32_t count)
+{
+    if( !count )
+    {
+        s << "null";
+        return;
+    }
+
+    const NPVariant &v = params[0];
+    if( NPVARIANT_IS_DOUBLE(v) )
+        append_number(s, NPVARIANT_TO_DOUBLE(v));
+    else if( NPVARIANT_IS_INT32(v) )
+        s << NPVARIANT_TO_INT32(v);
+    else if( NPVARIANT_IS_BOOLEAN(v) )
+        s << (NPVARIANT_TO_BOOLEAN(v) ? "true" : "false");
+    else if( NPVARIANT_IS_STRING(v) )
+    {
+        const NPString &str = NPVARIANT_TO_STRING(v);
+        s << '"';
+        for( uint32_t i = 0; i < str.UTF8Length; i++ )
+        {
+            unsigned char c = str.UTF8Characters[i];
+            if( c == '"' || c == '\\' )
+                s << '\\' << c;
+            else if( c < 0x20 )
+            {
+                static const char hex[] = "0123456789abcdef";
+                s << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+            }
+            else
+                s << c;
+        }
+        s << '"';
+    }
+    else
+        s << "null";
+}
+
+/* the whole delivery is built as one array literal, evaluated once and
+ * passed to each batch listener: two calls into the page in total */
+void EventObj::deliver_batch(NPP browser)
+{
+    std::ostringstream records;
+    records.imbue( std::locale::classic() );
+    records.precision( 17 );
+    records << '[';
+    bool first = true;
+    for( ev_l::iterator iter = _elist.begin(); iter != _elist.end(); ++iter )
+    {
+        int index = event_index( iter->event_type() );
+        if( index < 0 )
+            continue;
+
+        if( !first )
+            records << ',';
+        first = false;
+        records << "{type:\"" << vlcevents[index].name << "\",value:";
+        append_value( records, iter->params(), iter->count() );
+        /* milliseconds, monotonic clock */
+        records << ",timestamp:";
+        append_number( records, iter->time() / 1000. );
+        records << '}';
+    }
+    records << ']';
+
+    NPObject *window = NULL;
+    if( NPERR_NO_ERROR != NPN_GetValue(browser, NPNVWindowNPObject, &window) )
+        return;
+
+    const std::string &text = records.str();
+    NPString script;
+    script.UTF8Characters = text.c_str();
+    script.UTF8Length = text.size();
+
+    NPVariant array;
+    if( NPN_Evaluate(browser, window, &script, &array) )
+    {
+        /* listeners may add or remove batch listeners */
+        for( size_t i = 0; i < _batch_listeners.size(); i++ )
+        {
+            NPVariant result;
+            NPN_InvokeDefault( browser, _batch_listeners[i], &array, 1, &result );
+            NPN_ReleaseVariantValue( &result );
+        }
+        NPN_ReleaseVariantValue( &array );
+    }
+    NPN_ReleaseObject( window );
 }
 
 void EventObj::deliver(NPP browser)
 {
+    /* a listener running a nested event loop (alert(), a sync request)
+     * may get our eventAsync() called again: the events it was scheduled
+     * for are taken by one more round of the outer call */
     if(_already_in_deliver)
+    {
+        _deliver_skipped = true;
         return;
+    }
 
-    plugin_lock(&lock);
     _already_in_deliver = true;
+    do
+    {
+        _deliver_skipped = false;
+        if( take_queue() )
+            dispatch( browser );
+    }
+    while( _deliver_skipped );
+    _already_in_deliver = false;
+}
+
+/* take the whole queue first, no lock is held while calling the
+ * listeners so a slow page never blocks the libvlc threads */
+bool EventObj::take_queue()
+{
+    VLCEvent event;
+    while( pop(&event) )
+    {
+        /* a state-like event holds the newest value of its type */
+        int index = coalesce_index(event.event_type());
+        if( index >= 0 )
+        {
+            /* cleared first, a newer value queues a new event */
+            plugin_atomic_swap(&_latest[index].queued, 0);
+            int64_t time;
+            NPVariant value = _latest[index].load(&time);
+            event = VLCEvent(event.event_type(), &value, 1, time);
+        }
+        /* the media events follow the media being played */
+        if( event.event_type() == libvlc_MediaPlayerMediaChanged )
+            rehook_media();
+        _elist.push_back(event);
+    }
+    return !_elist.empty();
+}
+
+void EventObj::dispatch(NPP browser)
+{
+    int64_t now = libvlc_clock();
+    _drain++;
+    bool batch = !_elist.empty() && !_batch_listeners.empty();
+    if( batch )
+        deliver_batch( browser );
 
     for( ev_l::iterator iter = _elist.begin(); iter != _elist.end(); ++iter )
     {
         NPVariant *params = iter->params();
         uint32_t   count  = iter->count();
 
-        for( lr_l::iterator j = _llist.begin(); j != _llist.end(); ++j )
+        int index = event_index( iter->event_type() );
+        if( index >= 0 )
         {
-            if( j->event_type() == iter->event_type() )
+            bool handled = batch;
+            /* listeners may add or remove listeners */
+            lr_l &listeners = _ltable[index];
+            for( size_t j = 0; j < listeners.size(); ++j )
             {
+                if( !listeners[j].accept( params, count, now, _drain ) )
+                    continue;
+
                 NPVariant result;
-                NPObject *listener = j->listener();
+                NPObject *listener = listeners[j].listener();
                 assert( listener );
 
                 NPN_InvokeDefault( browser, listener, params, count, &result );
                 NPN_ReleaseVariantValue( &result );
-
-                for( uint32_t n = 0; n < count; n++ )
-                {
-                    if( NPVARIANT_IS_STRING(params[n]) )
-                    {
-                        NPN_MemFree( (void*) NPVARIANT_TO_STRING(params[n]).UTF8Characters );
-                    }
-                    else if( NPVARIANT_IS_OBJECT(params[n]) )
-                    {
-                        NPN_ReleaseObject( NPVARIANT_TO_OBJECT(params[n]) );
-                        NPN_MemFree( (void*)NPVARIANT_TO_OBJECT(params[n]) );
-                    }
-                }
-                if (params) NPN_MemFree( params );
+                handled = true;
             }
+
+            record( _latency[index].queued, now - iter->time() );
+            if( handled )
+                record( _latency[index].handled, libvlc_clock() - now );
         }
+
+        /* shared by all the listeners */
+        free_params( params, count );
     }
     _elist.clear();
 
-    _already_in_deliver = false;
-    plugin_unlock(&lock);
+    /* throttled listeners get the last value they missed */
+    for( size_t i = 0; i < _ltable.size(); i++ )
+    {
+        /* listeners may add or remove listeners */
+        for( size_t j = 0; j < _ltable[i].size(); ++j )
+        {
+            NPVariant params[EVENT_MAX_PARAMS];
+            uint32_t count;
+            if( !_ltable[i][j].trailing( params, &count, now, _drain ) )
+                continue;
+
+            NPVariant result;
+            NPN_InvokeDefault( browser, _ltable[i][j].listener(),
+                               params, count, &result );
+            NPN_ReleaseVariantValue( &result );
+        }
+    }
+}
+
+void EventObj::record(unsigned *histogram, int64_t duration)
+{
+    size_t i = 0;
+    while( i < EVENT_LATENCY_BUCKETS - 1 && duration >= ((int64_t)1 << i) )
+        i++;
+    histogram[i]++;
+}
+
+/* sets obj.id to child and drops our reference to child */
+static void set_object_property(NPP browser, NPObject *obj, NPIdentifier id,
+                                NPObject *child)
+{
+    NPVariant v;
+    OBJECT_TO_NPVARIANT( child, v );
+    NPN_SetProperty( browser, obj, id, &v );
+    NPN_ReleaseObject( child );
+}
+
+static NPObject *new_histogram(NPP browser, NPObject *window,
+                               const unsigned *histogram)
+{
+    NPObject *array = new_script_object(browser, window, "[]");
+    if( !array )
+        return NULL;
+
+    for( int32_t i = 0; i < EVENT_LATENCY_BUCKETS; i++ )
+    {
+        NPVariant v;
+        DOUBLE_TO_NPVARIANT( histogram[i], v );
+        NPN_SetProperty( browser, array, NPN_GetIntIdentifier(i), &v );
+    }
+    return array;
+}
+
+/* {limits: [1, 2, 4... us], dropped, coalesced,
+ *  events: {name: {queued: [counts], handled: [counts]}}},
+ * the last bucket counts everything longer, only the event types
+ * delivered since the last reset are listed */
+bool EventObj::latency(NPP browser, NPVariant *result)
+{
+    NPObject *window = NULL;
+    if( NPERR_NO_ERROR != NPN_GetValue(browser, NPNVWindowNPObject, &window) )
+        return false;
+
+    NPObject *obj = new_script_object(browser, window, "({})");
+    NPObject *limits = new_script_object(browser, window, "[]");
+    NPObject *events = new_script_object(browser, window, "({})");
+    if( !obj || !limits || !events )
+    {
+        if( obj )
+            NPN_ReleaseObject( obj );
+        if( limits )
+            NPN_ReleaseObject( limits );
+        if( events )
+            NPN_ReleaseObject( events );
+        NPN_ReleaseObject( window );
+        return false;
+    }
+
+    NPVariant v;
+    for( int32_t i = 0; i < EVENT_LATENCY_BUCKETS; i++ )
+    {
+        if( i < EVENT_LATENCY_BUCKETS - 1 )
+            DOUBLE_TO_NPVARIANT( (double)((int64_t)1 << i), v );
+        else
+            NULL_TO_NPVARIANT( v );
+        NPN_SetProperty( browser, limits, NPN_GetIntIdentifier(i), &v );
+    }
+    set_object_property( browser, obj, NPN_GetStringIdentifier("limits"), limits );
+    DOUBLE_TO_NPVARIANT( dropped(), v );
+    NPN_SetProperty( browser, obj, NPN_GetStringIdentifier("dropped"), &v );
+    DOUBLE_TO_NPVARIANT( coalesced(), v );
+    NPN_SetProperty( browser, obj, NPN_GetStringIdentifier("coalesced"), &v );
+
+    NPIdentifier queuedId = NPN_GetStringIdentifier("queued");
+    NPIdentifier handledId = NPN_GetStringIdentifier("handled");
+    for( size_t i = 0; i < _latency.size(); i++ )
+    {
+        const Latency &l = _latency[i];
+        unsigned total = 0;
+        for( size_t j = 0; j < EVENT_LATENCY_BUCKETS; j++ )
+            total += l.queued[j];
+        if( !total )
+            continue;
+
+        NPObject *type = new_script_object(browser, window, "({})");
+        if( !type )
+            break;
+        NPObject *queued = new_histogram(browser, window, l.queued);
+        if( queued )
+            set_object_property( browser, type, queuedId, queued );
+        NPObject *handled = new_histogram(browser, window, l.handled);
+        if( handled )
+            set_object_property( browser, type, handledId, handled );
+        set_object_property( browser, events,
+                             NPN_GetStringIdentifier(vlcevents[i].name), type );
+    }
+    set_object_property( browser, obj, NPN_GetStringIdentifier("events"), events );
+    NPN_ReleaseObject( window );
+
+    OBJECT_TO_NPVARIANT( obj, *result );
+    return true;
+}
+
+void EventObj::reset_latency()
+{
+    for( size_t i = 0; i < _latency.size(); i++ )
+        memset(&_latency[i], 0, sizeof(Latency));
+    plugin_atomic_swap(&_dropped, 0);
+    plugin_atomic_swap(&_coalesced, 0);
+}
+
+/* queues the event, or replaces the parameters of the undelivered
+ * event of the same type if it is state-like */
+bool EventObj::schedule(VLCEvent &event)
+{
+    int index = coalesce_index(event.event_type());
+    if( index < 0 || event.count() != 1 )
+        return push(event);
+
+    /* state values are numbers, replacing one frees nothing */
+    _latest[index].store(event.params()[0], event.time());
+    if( plugin_atomic_swap(&_latest[index].queued, 1) )
+    {
+        /* already queued, deliver() will pick the new value */
+        plugin_atomic_add(&_coalesced, 1);
+        return true;
+    }
+
+    /* the value itself lives in _latest */
+    if( push(VLCEvent(event.event_type(), NULL, 0, event.time())) )
+        return true;
+
+    plugin_atomic_swap(&_latest[index].queued, 0);
+    return false;
 }
 
 void EventObj::callback(const libvlc_event_t* event,
-                        NPVariant *npparams, uint32_t count)
+                        const NPVariant *npparams, uint32_t count)
 {
-    plugin_lock(&lock);
-    _elist.push_back(VLCEvent(event->type, npparams, count));
-    plugin_unlock(&lock);
+    VLCEvent vlc_event(event->type, npparams, count, libvlc_clock());
+    if( !schedule(vlc_event) )
+    {
+        plugin_atomic_add(&_dropped, 1);
+        free_params(vlc_event.params(), count);
+    }
 }
 
 vlcplugin_event_t *EventObj::find_event(const NPString &name) const
@@ -185,23 +728,35 @@ vlcplugin_event_t *EventObj::find_event(const NPString &name) const
     return NULL;
 }
 
-bool EventObj::insert(const NPString &name, NPObject *listener, bool bubble)
+int EventObj::event_index(libvlc_event_type_t type)
+{
+    for( size_t i = 0; i < ARRAY_SIZE(vlcevents); i++ )
+    {
+        if( vlcevents[i].libvlc_type == type )
+            return i;
+    }
+    return -1;
+}
+
+bool EventObj::insert(const NPString &name, NPObject *listener, bool bubble,
+                      double max_rate, double min_delta)
 {
     vlcplugin_event_t *event = find_event(name);
     if( !event )
         return false;
 
-    for( lr_l::iterator iter = _llist.begin(); iter != _llist.end(); ++iter )
+    lr_l &listeners = _ltable[event - vlcevents];
+    for( lr_l::iterator iter = listeners.begin(); iter != listeners.end(); ++iter )
     {
         if( iter->listener() == listener &&
-            event->libvlc_type == iter->event_type() &&
             iter->bubble() == bubble )
         {
             return false;
         }
     }
 
-    _llist.push_back( Listener(event, listener, bubble) );
+    listeners.push_back( Listener(event, listener, bubble, max_rate, min_delta) );
+    update_hook( event - vlcevents );
     return true;
 }
 
@@ -211,48 +766,199 @@ bool EventObj::remove(const NPString &name, NPObject *listener, bool bubble)
     if( !event )
         return false;
 
-    for( lr_l::iterator iter = _llist.begin(); iter !=_llist.end(); iter++ )
+    lr_l &listeners = _ltable[event - vlcevents];
+    for( lr_l::iterator iter = listeners.begin(); iter != listeners.end(); iter++ )
     {
-        if( iter->event_type() == event->libvlc_type &&
-            iter->listener() == listener &&
+        if( iter->listener() == listener &&
             iter->bubble() == bubble )
         {
-            iter = _llist.erase(iter);
+            listeners.erase(iter);
+            update_hook( event - vlcevents );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool EventObj::insert_batch(NPObject *listener)
+{
+    for( size_t i = 0; i < _batch_listeners.size(); i++ )
+    {
+        if( _batch_listeners[i] == listener )
+            return false;
+    }
+
+    _batch_listeners.push_back( listener );
+    if( _batch_listeners.size() == 1 )
+    {
+        /* every event may now be delivered */
+        for( size_t i = 0; i < ARRAY_SIZE(vlcevents); i++ )
+            update_hook( i );
+    }
+    return true;
+}
+
+bool EventObj::remove_batch(NPObject *listener)
+{
+    for( size_t i = 0; i < _batch_listeners.size(); i++ )
+    {
+        if( _batch_listeners[i] == listener )
+        {
+            _batch_listeners.erase( _batch_listeners.begin() + i );
+            if( _batch_listeners.empty() )
+            {
+                for( size_t j = 0; j < ARRAY_SIZE(vlcevents); j++ )
+                    update_hook( j );
+            }
             return true;
         }
     }
+    return false;
+}
+
+bool EventObj::hook_needed( size_t index ) const
+{
+    if( !_ltable[index].empty() || !_batch_listeners.empty() )
+        return true;
+    if( vlcevents[index].source == EVENT_SOURCE_PLAYER && _hold_all )
+        return true;
 
+    /* keeps the media events on the current media */
+    if( vlcevents[index].libvlc_type == libvlc_MediaPlayerMediaChanged )
+    {
+        for( size_t i = 0; i < ARRAY_SIZE(vlcevents); i++ )
+        {
+            if( vlcevents[i].source == EVENT_SOURCE_MEDIA &&
+                !_ltable[i].empty() )
+                return true;
+        }
+    }
     return false;
 }
 
-void EventObj::hook_manager( libvlc_event_manager_t *em, void *userdata )
+/* attaches the event while somebody needs it, so that instances without
+ * listeners pay nothing for the frequent ones (TimeChanged...) */
+void EventObj::update_hook( size_t index )
 {
+    if( vlcevents[index].source == EVENT_SOURCE_MEDIA )
+        update_hook( event_index(libvlc_MediaPlayerMediaChanged) );
+
+    libvlc_event_manager_t *em = _em[vlcevents[index].source];
     if( !em )
         return;
 
-    _em = em;
+    bool needed = hook_needed( index );
+    if( needed == _attached[index] )
+        return;
+
+    if( needed )
+        libvlc_event_attach( em, vlcevents[index].libvlc_type,
+                vlcevents[index].libvlc_callback,
+                _userdata );
+    else
+        libvlc_event_detach( em, vlcevents[index].libvlc_type,
+                vlcevents[index].libvlc_callback,
+                _userdata );
+    _attached[index] = needed;
+
+    /* the media may have changed while nobody was following it */
+    if( vlcevents[index].libvlc_type == libvlc_MediaPlayerMediaChanged )
+        rehook_media();
+}
+
+/* moves the media events to the media currently set on the player,
+ * browser thread only */
+void EventObj::rehook_media()
+{
+    if( !_player )
+        return;
+
+    libvlc_media_t *media = NULL;
+    if( _attached[event_index(libvlc_MediaPlayerMediaChanged)] )
+        media = libvlc_media_player_get_media( _player->get_mp() );
+    if( media == _media )
+    {
+        if( media )
+            libvlc_media_release( media );
+        return;
+    }
 
-    /* attach all libvlc events we need */
     for( size_t i = 0; i < ARRAY_SIZE(vlcevents); i++ )
     {
-        libvlc_event_attach( _em, vlcevents[i].libvlc_type,
+        if( vlcevents[i].source != EVENT_SOURCE_MEDIA || !_attached[i] )
+            continue;
+        libvlc_event_detach( _em[EVENT_SOURCE_MEDIA], vlcevents[i].libvlc_type,
                 vlcevents[i].libvlc_callback,
-                userdata );
+                _userdata );
+        _attached[i] = false;
+    }
+    if( _media )
+        libvlc_media_release( _media );
+
+    _media = media;
+    _em[EVENT_SOURCE_MEDIA] = media ? libvlc_media_event_manager( media ) : NULL;
+    if( !media )
+        return;
+
+    for( size_t i = 0; i < ARRAY_SIZE(vlcevents); i++ )
+    {
+        if( vlcevents[i].source == EVENT_SOURCE_MEDIA )
+            update_hook( i );
     }
+
+    /* it may have been parsed before we got there */
+    int index = event_index(libvlc_MediaParsedChanged);
+    if( _attached[index] && libvlc_media_is_parsed( media ) )
+    {
+        libvlc_event_t event;
+        event.type = libvlc_MediaParsedChanged;
+        event.p_obj = media;
+        event.u.media_parsed_changed.new_status = 1;
+        vlcevents[index].libvlc_callback( &event, _userdata );
+    }
+}
+
+void EventObj::hook_manager( vlc_player *player, void *userdata,
+                             bool hold_all )
+{
+    if( !player || !player->get_mp() )
+        return;
+
+    _player = player;
+    _em[EVENT_SOURCE_PLAYER] =
+        libvlc_media_player_event_manager( player->get_mp() );
+    _em[EVENT_SOURCE_LIST] = player->get_ml() ?
+        libvlc_media_list_event_manager( player->get_ml() ) : NULL;
+    _em[EVENT_SOURCE_LIST_PLAYER] = player->get_mlp() ?
+        libvlc_media_list_player_event_manager( player->get_mlp() ) : NULL;
+    _userdata = userdata;
+    _hold_all = hold_all;
+
+    /* attach the libvlc events we need */
+    for( size_t i = 0; i < ARRAY_SIZE(vlcevents); i++ )
+        update_hook( i );
 }
 
 void EventObj::unhook_manager( void *userdata )
 {
-    if( !_em )
+    if( !_player )
         return;
 
-    /* detach all libvlc events */
+    /* detach all attached libvlc events */
     for( size_t i = 0; i < ARRAY_SIZE(vlcevents); i++ )
     {
-        libvlc_event_detach( _em, vlcevents[i].libvlc_type,
+        if( !_attached[i] )
+            continue;
+        libvlc_event_detach( _em[vlcevents[i].source], vlcevents[i].libvlc_type,
                 vlcevents[i].libvlc_callback,
                 userdata );
+        _attached[i] = false;
     }
+    if( _media )
+        libvlc_media_release( _media );
+    _media = NULL;
+    for( size_t i = 0; i < EVENT_SOURCES; i++ )
+        _em[i] = NULL;
+    _player = NULL;
 }
-
-
@@ -34,10 +34,31 @@
 #include "common.h"
 #include "../common/vlc_player.h"
 
+enum {
+    /* scheduled events waiting for delivery, must be a power of 2 */
+    EVENT_QUEUE_SIZE = 256,
+    /* state-like events, see coalesce_index() */
+    EVENT_COALESCED_TYPES = 3,
+    /* parameters stored inline in queued events */
+    EVENT_MAX_PARAMS = 1,
+    /* latency histograms, bucket i counts durations below 2^i us */
+    EVENT_LATENCY_BUCKETS = 24
+};
+
+/* libvlc objects sending the events */
+enum vlcplugin_event_source_t {
+    EVENT_SOURCE_PLAYER = 0,  /* media player */
+    EVENT_SOURCE_MEDIA,       /* current media of the media player */
+    EVENT_SOURCE_LIST,        /* media list (playlist) */
+    EVENT_SOURCE_LIST_PLAYER, /* media list player */
+    EVENT_SOURCES
+};
+
 typedef struct {
     const char *name;                      /* event name */
     const libvlc_event_type_t libvlc_type; /* libvlc event type */
     libvlc_callback_t libvlc_callback;     /* libvlc callback function */
+    vlcplugin_event_source_t source;       /* event manager to attach to */
 } vlcplugin_event_t;
 
 class EventObj
@@ -47,8 +68,13 @@ private:
     class Listener
     {
     public:
-        Listener(vlcplugin_event_t *event, NPObject *p_object, bool b_bubble):
-            _event(event), _listener(p_object), _bubble(b_bubble)
+        Listener(vlcplugin_event_t *event, NPObject *p_object, bool b_bubble,
+                 double max_rate, double min_delta):
+            _event(event), _listener(p_object), _bubble(b_bubble),
+            _min_interval(max_rate > 0 ? (int64_t)(1000000 / max_rate) : 0),
+            _min_delta(min_delta > 0 ? min_delta : 0),
+            _last_time(0), _last_value(0), _called(false),
+            _trailing_count(0), _trailing_drain(0), _trailing(false)
         {
                 assert(event);
                 assert(p_object);
@@ -57,26 +83,88 @@ private:
         libvlc_event_type_t event_type() const { return _event->libvlc_type; }
         NPObject *listener() const { return _listener; }
         bool bubble() const { return _bubble; }
+
+        /* false if the listener asked for fewer or larger updates, the
+         * event is then kept for a trailing delivery */
+        bool accept(const NPVariant *params, uint32_t count, int64_t now,
+                    unsigned drain);
+        /* the last suppressed event, once a later drain finds the
+         * listener ready for it, so it never keeps a stale value */
+        bool trailing(NPVariant *params, uint32_t *count, int64_t now,
+                      unsigned drain);
     private:
+        bool ready(const NPVariant *params, uint32_t count, int64_t now);
+
         vlcplugin_event_t *_event;
         NPObject *_listener;
         bool _bubble;
+
+        /* options of addEventListener */
+        int64_t _min_interval; /* us, from maxRate (calls per second) */
+        double _min_delta;     /* smallest change of a numeric value */
+        int64_t _last_time;
+        double _last_value;
+        bool _called;
+
+        /* event values are numbers or booleans, kept by value */
+        NPVariant _trailing_params[EVENT_MAX_PARAMS];
+        uint32_t _trailing_count;
+        unsigned _trailing_drain;
+        bool _trailing;
     };
 
     class VLCEvent
     {
     public:
-        VLCEvent(libvlc_event_type_t libvlc_event_type, NPVariant *npparams, uint32_t npcount):
-            _libvlc_event_type(libvlc_event_type), _npparams(npparams), _npcount(npcount)
-         {}
+        VLCEvent(): _libvlc_event_type(0), _npcount(0), _time(0) {}
+        VLCEvent(libvlc_event_type_t libvlc_event_type, const NPVariant *npparams, uint32_t npcount,
+                 int64_t time):
+            _libvlc_event_type(libvlc_event_type), _npcount(npcount), _time(time)
+        {
+            assert(npcount <= EVENT_MAX_PARAMS);
+            for( uint32_t i = 0; i < npcount; i++ )
+                _npparams[i] = npparams[i];
+        }
 
         libvlc_event_type_t event_type() const { return _libvlc_event_type; }
-        NPVariant *params() const { return _npparams; }
+        NPVariant *params() { return _npcount ? _npparams : NULL; }
         uint32_t count() const { return _npcount; }
+        int64_t time() const { return _time; }
     private:
         libvlc_event_type_t _libvlc_event_type;
-        NPVariant *_npparams;
+        /* inline: queuing an event allocates nothing */
+        NPVariant _npparams[EVENT_MAX_PARAMS];
         uint32_t _npcount;
+        int64_t _time; /* libvlc_clock() when libvlc sent it */
+    };
+
+    /* bounded multi-producer (libvlc threads) single-consumer (browser
+     * thread) ring, a slot is free for position p when seq == p and
+     * holds an event when seq == p + 1 */
+    struct EventSlot
+    {
+        plugin_atomic_t seq;
+        VLCEvent event;
+    };
+
+    /* newest value of a state-like event type, a sequence lock lets the
+     * browser thread read it while libvlc threads replace it */
+    struct StateSlot
+    {
+        plugin_atomic_t seq;    /* odd while being written */
+        plugin_atomic_t queued; /* an event of this type waits in the ring */
+        NPVariant value;
+        int64_t time;
+
+        void store(const NPVariant &v, int64_t t);
+        NPVariant load(int64_t *t);
+    };
+
+    /* delivery latencies of an event type, browser thread only */
+    struct Latency
+    {
+        unsigned queued[EVENT_LATENCY_BUCKETS];  /* callback to deliver */
+        unsigned handled[EVENT_LATENCY_BUCKETS]; /* deliver to listeners return */
     };
 
 public:
@@ -84,24 +172,76 @@ public:
     virtual ~EventObj();
 
     void unhook_manager(void *);
-    void hook_manager(libvlc_event_manager_t *, void *);
+    /* events are attached while they have listeners, or always for the
+     * media player ones if hold_all is set */
+    void hook_manager(vlc_player *, void *, bool hold_all = false);
 
     void deliver(NPP browser);
-    void callback(const libvlc_event_t *event, NPVariant *npparams, uint32_t count);
-    bool insert(const NPString &name, NPObject *listener, bool bubble);
+    void callback(const libvlc_event_t *event, const NPVariant *npparams, uint32_t count);
+    /* events dropped because the queue was full */
+    unsigned dropped() { return plugin_atomic_get(&_dropped); }
+    /* events replaced by a newer one of the same type before delivery */
+    unsigned coalesced() { return plugin_atomic_get(&_coalesced); }
+    bool insert(const NPString &name, NPObject *listener, bool bubble,
+                double max_rate = 0, double min_delta = 0);
     bool remove(const NPString &name, NPObject *listener, bool bubble);
+    /* listeners receiving all the events of a delivery in one call */
+    bool insert_batch(NPObject *listener);
+    bool remove_batch(NPObject *listener);
+    /* histograms of the delivery latencies, as a javascript object */
+    bool latency(NPP browser, NPVariant *result);
+    void reset_latency();
 
 private:
-    libvlc_event_manager_t *_em; /* libvlc media_player event manager */
+    libvlc_event_manager_t *_em[EVENT_SOURCES]; /* libvlc event managers */
+    vlc_player *_player;
+    libvlc_media_t *_media;      /* current media, source of the media events */
+    void *_userdata;             /* of the libvlc callbacks */
+    bool _hold_all;
+    std::vector<bool> _attached; /* by event index */
+    bool hook_needed(size_t index) const;
+    void update_hook(size_t index);
+    void rehook_media();
+
     vlcplugin_event_t *find_event(const NPString &name) const;
+    static int event_index(libvlc_event_type_t type);
+
+    bool push(const VLCEvent &event);
+    bool schedule(VLCEvent &event);
+    static int coalesce_index(libvlc_event_type_t type);
+    bool pop(VLCEvent *event);
+    static void free_params(NPVariant *params, uint32_t count);
+    bool take_queue();
+    void dispatch(NPP browser);
+    void deliver_batch(NPP browser);
+    static void record(unsigned *histogram, int64_t duration);
 
     typedef std::vector<Listener> lr_l;
     typedef std::vector<VLCEvent> ev_l;
-    lr_l _llist; /* list of registered listeners with 'addEventListener' method */
-    ev_l _elist; /* scheduled events list for delivery to browser */
+    /* listeners registered with 'addEventListener' method, indexed by
+     * the position of their event in vlcevents[] */
+    std::vector<lr_l> _ltable;
+    ev_l _elist; /* events being delivered, browser thread only */
+    std::vector<NPObject *> _batch_listeners;
+
+    /* scheduled events for delivery to browser */
+    EventSlot _queue[EVENT_QUEUE_SIZE];
+    plugin_atomic_t _queue_tail; /* next position to write */
+    unsigned long _queue_head;   /* next position to read */
+    /* overflow policy: the newest event is dropped, the page keeps the
+     * order of what it already has to handle */
+    plugin_atomic_t _dropped;
+
+    /* only the first undelivered occurrence of a state-like event type
+     * is queued, and carries the newest value */
+    StateSlot _latest[EVENT_COALESCED_TYPES];
+    plugin_atomic_t _coalesced;
+
+    std::vector<Latency> _latency; /* by event index */
 
-    plugin_lock_t lock;
     bool _already_in_deliver;
+    bool _deliver_skipped; /* a nested deliver() returned at once */
+    unsigned _drain; /* dispatch() calls, browser thread only */
 };
 
 #endif
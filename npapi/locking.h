@@ -102,4 +102,63 @@ static void plugin_unlock(plugin_lock_t *lock)
 #endif
 }
 
+/*****************************************************************************
+ * Atomic utility functions (full barriers)
+ *****************************************************************************/
+typedef volatile long plugin_atomic_t;
+
+static long plugin_atomic_add(plugin_atomic_t *value, long delta)
+{
+    assert(value);
+
+#if defined(XP_WIN)
+    return InterlockedExchangeAdd(value, delta) + delta;
+#elif defined(__GNUC__)
+    return __sync_add_and_fetch(value, delta);
+#else
+#warning "atomics not implemented in this platform"
+    return *value += delta;
+#endif
+}
+
+static long plugin_atomic_get(plugin_atomic_t *value)
+{
+    return plugin_atomic_add(value, 0);
+}
+
+/* returns true if *value was old_value and has been replaced */
+static bool plugin_atomic_cas(plugin_atomic_t *value,
+                              long old_value, long new_value)
+{
+    assert(value);
+
+#if defined(XP_WIN)
+    return InterlockedCompareExchange(value, new_value, old_value) == old_value;
+#elif defined(__GNUC__)
+    return __sync_bool_compare_and_swap(value, old_value, new_value);
+#else
+#warning "atomics not implemented in this platform"
+    if( *value != old_value )
+        return false;
+    *value = new_value;
+    return true;
+#endif
+}
+
+/* returns the previous value */
+static long plugin_atomic_swap(plugin_atomic_t *value, long new_value)
+{
+    assert(value);
+
+#if defined(XP_WIN)
+    return InterlockedExchange(value, new_value);
+#else
+    long old_value;
+    do
+        old_value = *value;
+    while( !plugin_atomic_cas(value, old_value, new_value) );
+    return old_value;
+#endif
+}
+
 #endif
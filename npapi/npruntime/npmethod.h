@@ -0,0 +1,256 @@
+/*****************************************************************************
+ * npmethod.h: typed arguments and results of script methods
+ *****************************************************************************
+ * Copyright (C) 2013 VLC authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef __NPMETHOD_H__
+#define __NPMETHOD_H__
+
+/*
+** Declares the signature of a script method and converts its arguments
+** without heap allocation in the common case:
+**
+**     Method<void(const char *)> m;
+**     if( !m.bind(args, argCount) )
+**         return INVOKERESULT_NO_SUCH_METHOD;
+**     libvlc_video_set_deinterlace(p_md, m.arg1);
+**     return m.result(result);
+**
+** Supported argument types are int, double, bool, NPString (a view on
+** the browser string), const char * (a nul terminated copy) and
+** NPObject *. Property setters use NPArg<T>::get() directly.
+*/
+
+#include "nporuntime.h"
+
+#include <string.h>
+
+enum {
+    // longer strings are copied to the heap
+    NPCSTRING_STACK_SIZE = 256
+};
+
+/* nul terminated copy of a NPString, on the stack when short enough */
+class NPCString
+{
+public:
+    NPCString() : _heap(NULL) { _buf[0] = '\0'; };
+    ~NPCString() { free(_heap); };
+
+    bool set(const NPString &s)
+    {
+        free(_heap);
+        _heap = NULL;
+
+        char *dst = _buf;
+        if( s.UTF8Length >= sizeof(_buf) )
+        {
+            dst = _heap = static_cast<char *>(malloc(s.UTF8Length + 1));
+            if( !dst )
+                return false;
+        }
+        memcpy(dst, s.UTF8Characters, s.UTF8Length);
+        dst[s.UTF8Length] = '\0';
+        return true;
+    };
+
+    const char *c_str() const { return _heap ? _heap : _buf; };
+    operator const char *() const { return c_str(); };
+
+private:
+    NPCString(const NPCString &);
+    NPCString &operator=(const NPCString &);
+
+    char _buf[NPCSTRING_STACK_SIZE];
+    char *_heap;
+};
+
+template<class T> struct NPArg;
+
+template<> struct NPArg<int>
+{
+    typedef int storage;
+    static bool get(const NPVariant &v, storage &out)
+    {
+        if( !RuntimeNPObject::isNumberValue(v) )
+            return false;
+        out = RuntimeNPObject::intValue(v);
+        return true;
+    };
+};
+
+template<> struct NPArg<double>
+{
+    typedef double storage;
+    static bool get(const NPVariant &v, storage &out)
+    {
+        if( !RuntimeNPObject::isNumberValue(v) )
+            return false;
+        out = RuntimeNPObject::doubleValue(v);
+        return true;
+    };
+};
+
+template<> struct NPArg<bool>
+{
+    typedef bool storage;
+    static bool get(const NPVariant &v, storage &out)
+    {
+        if( !RuntimeNPObject::isBoolValue(v) )
+            return false;
+        out = RuntimeNPObject::boolValue(v);
+        return true;
+    };
+};
+
+/* not nul terminated, valid while the arguments are */
+template<> struct NPArg<NPString>
+{
+    typedef NPString storage;
+    static bool get(const NPVariant &v, storage &out)
+    {
+        if( !NPVARIANT_IS_STRING(v) )
+            return false;
+        out = NPVARIANT_TO_STRING(v);
+        return true;
+    };
+};
+
+template<> struct NPArg<const char *>
+{
+    typedef NPCString storage;
+    static bool get(const NPVariant &v, storage &out)
+    {
+        return NPVARIANT_IS_STRING(v) && out.set(NPVARIANT_TO_STRING(v));
+    };
+};
+
+template<> struct NPArg<NPObject *>
+{
+    typedef NPObject *storage;
+    static bool get(const NPVariant &v, storage &out)
+    {
+        if( !NPVARIANT_IS_OBJECT(v) )
+            return false;
+        out = NPVARIANT_TO_OBJECT(v);
+        return true;
+    };
+};
+
+template<class R> struct MethodResult
+{
+    static RuntimeNPObject::InvokeResult result(R value, NPVariant &result);
+};
+
+template<> inline RuntimeNPObject::InvokeResult
+MethodResult<int>::result(int value, NPVariant &result)
+{
+    INT32_TO_NPVARIANT(value, result);
+    return RuntimeNPObject::INVOKERESULT_NO_ERROR;
+}
+
+template<> inline RuntimeNPObject::InvokeResult
+MethodResult<double>::result(double value, NPVariant &result)
+{
+    DOUBLE_TO_NPVARIANT(value, result);
+    return RuntimeNPObject::INVOKERESULT_NO_ERROR;
+}
+
+template<> inline RuntimeNPObject::InvokeResult
+MethodResult<bool>::result(bool value, NPVariant &result)
+{
+    BOOLEAN_TO_NPVARIANT(value, result);
+    return RuntimeNPObject::INVOKERESULT_NO_ERROR;
+}
+
+/* a single copy, into memory the browser frees */
+template<> inline RuntimeNPObject::InvokeResult
+MethodResult<const char *>::result(const char *value, NPVariant &result)
+{
+    return RuntimeNPObject::invokeResultString(value, result);
+}
+
+template<> struct MethodResult<void>
+{
+    static RuntimeNPObject::InvokeResult result(NPVariant &result)
+    {
+        VOID_TO_NPVARIANT(result);
+        return RuntimeNPObject::INVOKERESULT_NO_ERROR;
+    };
+};
+
+/* no variadic templates: one specialization per arity */
+template<class Signature> class Method;
+
+template<class R>
+class Method<R()> : public MethodResult<R>
+{
+public:
+    bool bind(const NPVariant *, uint32_t argCount)
+    {
+        return argCount == 0;
+    };
+};
+
+template<class R, class A1>
+class Method<R(A1)> : public MethodResult<R>
+{
+public:
+    bool bind(const NPVariant *args, uint32_t argCount)
+    {
+        return argCount == 1
+            && NPArg<A1>::get(args[0], arg1);
+    };
+
+    typename NPArg<A1>::storage arg1;
+};
+
+template<class R, class A1, class A2>
+class Method<R(A1, A2)> : public MethodResult<R>
+{
+public:
+    bool bind(const NPVariant *args, uint32_t argCount)
+    {
+        return argCount == 2
+            && NPArg<A1>::get(args[0], arg1)
+            && NPArg<A2>::get(args[1], arg2);
+    };
+
+    typename NPArg<A1>::storage arg1;
+    typename NPArg<A2>::storage arg2;
+};
+
+template<class R, class A1, class A2, class A3>
+class Method<R(A1, A2, A3)> : public MethodResult<R>
+{
+public:
+    bool bind(const NPVariant *args, uint32_t argCount)
+    {
+        return argCount == 3
+            && NPArg<A1>::get(args[0], arg1)
+            && NPArg<A2>::get(args[1], arg2)
+            && NPArg<A3>::get(args[2], arg3);
+    };
+
+    typename NPArg<A1>::storage arg1;
+    typename NPArg<A2>::storage arg2;
+    typename NPArg<A3>::storage arg3;
+};
+
+#endif
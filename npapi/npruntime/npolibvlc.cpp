@@ -27,8 +27,12 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include <string>
+#include <vector>
+
 #include "vlcplugin.h"
 #include "npolibvlc.h"
+#include "npmethod.h"
 
 #include "../../common/position.h"
 
@@ -101,7 +105,8 @@ const NPUTF8 * const LibvlcRootNPObject::propertyNames[] =
     "subtitle",
     "video",
     "VersionInfo",
-    "mediaDescription"
+    "mediaDescription",
+    "eventLatency"
 };
 COUNTNAMES(LibvlcRootNPObject,propertyCount,propertyNames);
 
@@ -114,6 +119,7 @@ enum LibvlcRootNPObjectPropertyIds
     ID_root_video,
     ID_root_VersionInfo,
     ID_root_MediaDescription,
+    ID_root_EventLatency,
 };
 
 RuntimeNPObject::InvokeResult
@@ -152,6 +158,13 @@ LibvlcRootNPObject::getProperty(int index, NPVariant &result)
                 OBJECT_TO_NPVARIANT(NPN_RetainObject(mediaDescriptionObj), result);
                 return INVOKERESULT_NO_ERROR;
             }
+            case ID_root_EventLatency:
+            {
+                VlcPluginBase* p_plugin = getPrivate<VlcPluginBase>();
+                if( !p_plugin->events.latency(_instance, &result) )
+                    return INVOKERESULT_GENERIC_ERROR;
+                return INVOKERESULT_NO_ERROR;
+            }
             default:
                 ;
         }
@@ -164,6 +177,10 @@ const NPUTF8 * const LibvlcRootNPObject::methodNames[] =
     "versionInfo",
     "addEventListener",
     "removeEventListener",
+    "addBatchListener",
+    "removeBatchListener",
+    "resetEventLatency",
+    "exec",
 };
 COUNTNAMES(LibvlcRootNPObject,methodCount,methodNames);
 
@@ -172,8 +189,166 @@ enum LibvlcRootNPObjectMethodIds
     ID_root_versionInfo,
     ID_root_addeventlistener,
     ID_root_removeeventlistener,
+    ID_root_addbatchlistener,
+    ID_root_removebatchlistener,
+    ID_root_reseteventlatency,
+    ID_root_exec,
 };
 
+enum {
+    // no script method takes more, a longer argument list is an error
+    EXEC_MAX_ARGS = 8
+};
+
+static int32_t arrayLength(NPP instance, NPObject *array)
+{
+    NPVariant length;
+    if( !NPN_GetProperty(instance, array, NPN_GetStringIdentifier("length"), &length) )
+        return 0;
+    int32_t count = 0;
+    if( RuntimeNPObject::isNumberValue(length) )
+        count = RuntimeNPObject::intValue(length);
+    NPN_ReleaseVariantValue(&length);
+    return count > 0 ? count : 0;
+}
+
+static bool arrayElement(NPP instance, NPObject *array, int32_t i, NPVariant *v)
+{
+    if( NPN_GetProperty(instance, array, NPN_GetIntIdentifier(i), v) )
+        return true;
+    VOID_TO_NPVARIANT(*v);
+    return false;
+}
+
+/* the object at a dotted property path from the root object, "" being
+ * the root itself, returned retained */
+RuntimeNPObject::InvokeResult
+LibvlcRootNPObject::resolveTarget(const std::string &path, RuntimeNPObject **target)
+{
+    RuntimeNPObject *obj = this;
+    NPN_RetainObject(obj);
+
+    size_t start = 0;
+    while( start < path.size() )
+    {
+        size_t end = path.find('.', start);
+        if( end == std::string::npos )
+            end = path.size();
+        std::string name = path.substr(start, end - start);
+        start = end + 1;
+
+        if( !obj->isValid() )
+        {
+            NPN_ReleaseObject(obj);
+            return INVOKERESULT_GENERIC_ERROR;
+        }
+
+        const RuntimeNPClassBase *vClass =
+            static_cast<const RuntimeNPClassBase *>(obj->_class);
+        int index = vClass->indexOfProperty(NPN_GetStringIdentifier(name.c_str()));
+
+        NPVariant child;
+        VOID_TO_NPVARIANT(child);
+        InvokeResult r = index < 0 ? INVOKERESULT_NO_SUCH_METHOD
+                                   : obj->getProperty(index, child);
+        NPN_ReleaseObject(obj);
+        if( r != INVOKERESULT_NO_ERROR )
+            return r;
+        /* some properties are script objects of the page (eventLatency) */
+        if( !NPVARIANT_IS_OBJECT(child) ||
+            !RuntimeNPClassBase::isRuntimeObject(NPVARIANT_TO_OBJECT(child)) )
+        {
+            NPN_ReleaseVariantValue(&child);
+            return INVOKERESULT_INVALID_ARGS;
+        }
+        obj = static_cast<RuntimeNPObject *>(NPVARIANT_TO_OBJECT(child));
+    }
+    *target = obj;
+    return INVOKERESULT_NO_ERROR;
+}
+
+/* [target, op, args]: op is a method of the target, or one of its
+ * properties, set to args[0] if given and read otherwise */
+RuntimeNPObject::InvokeResult
+LibvlcRootNPObject::execCommand(NPObject *command, NPVariant &value)
+{
+    VOID_TO_NPVARIANT(value);
+
+    NPVariant target, op;
+    arrayElement(_instance, command, 0, &target);
+    arrayElement(_instance, command, 1, &op);
+    bool valid = NPVARIANT_IS_STRING(target) && NPVARIANT_IS_STRING(op);
+    std::string path, name;
+    if( valid )
+    {
+        path.assign(NPVARIANT_TO_STRING(target).UTF8Characters,
+                    NPVARIANT_TO_STRING(target).UTF8Length);
+        name.assign(NPVARIANT_TO_STRING(op).UTF8Characters,
+                    NPVARIANT_TO_STRING(op).UTF8Length);
+    }
+    NPN_ReleaseVariantValue(&target);
+    NPN_ReleaseVariantValue(&op);
+    if( !valid )
+        return INVOKERESULT_INVALID_ARGS;
+
+    std::vector<NPVariant> args;
+    NPVariant list;
+    arrayElement(_instance, command, 2, &list);
+    if( NPVARIANT_IS_OBJECT(list) )
+    {
+        /* the length comes from the page, it is not trusted */
+        int32_t count = arrayLength(_instance, NPVARIANT_TO_OBJECT(list));
+        if( count > EXEC_MAX_ARGS )
+        {
+            NPN_ReleaseVariantValue(&list);
+            return INVOKERESULT_INVALID_ARGS;
+        }
+        args.resize(count);
+        for( int32_t i = 0; i < count; ++i )
+            arrayElement(_instance, NPVARIANT_TO_OBJECT(list), i, &args[i]);
+    }
+    else if( !NPVARIANT_IS_VOID(list) && !NPVARIANT_IS_NULL(list) )
+    {
+        NPN_ReleaseVariantValue(&list);
+        return INVOKERESULT_INVALID_ARGS;
+    }
+    NPN_ReleaseVariantValue(&list);
+
+    RuntimeNPObject *obj = NULL;
+    InvokeResult r = resolveTarget(path, &obj);
+    if( r == INVOKERESULT_NO_ERROR )
+    {
+        const RuntimeNPClassBase *vClass =
+            static_cast<const RuntimeNPClassBase *>(obj->_class);
+        NPIdentifier id = NPN_GetStringIdentifier(name.c_str());
+        int index;
+        if( !obj->isValid() )
+            r = INVOKERESULT_GENERIC_ERROR;
+        else if( (index = vClass->indexOfMethod(id)) != -1 )
+            r = obj->invoke(index, args.empty() ? NULL : &args[0],
+                            args.size(), value);
+        else if( (index = vClass->indexOfProperty(id)) != -1 )
+        {
+            if( args.empty() )
+                r = obj->getProperty(index, value);
+            else if( args.size() == 1 )
+            {
+                r = obj->setProperty(index, args[0]);
+                VOID_TO_NPVARIANT(value);
+            }
+            else
+                r = INVOKERESULT_INVALID_ARGS;
+        }
+        else
+            r = INVOKERESULT_NO_SUCH_METHOD;
+        NPN_ReleaseObject(obj);
+    }
+
+    for( size_t i = 0; i < args.size(); ++i )
+        NPN_ReleaseVariantValue(&args[i]);
+    return r;
+}
+
 RuntimeNPObject::InvokeResult LibvlcRootNPObject::invoke(int index,
                   const NPVariant *args, uint32_t argCount, NPVariant &result)
 {
@@ -188,9 +363,121 @@ RuntimeNPObject::InvokeResult LibvlcRootNPObject::invoke(int index,
             return INVOKERESULT_NO_SUCH_METHOD;
         return invokeResultString(libvlc_get_version(),result);
 
+    /* exec([[target, op, args], ...]) runs the commands in order and
+     * returns one {value} or {error} record per command */
+    case ID_root_exec:
+    {
+        if( 1 != argCount || !NPVARIANT_IS_OBJECT(args[0]) )
+            return INVOKERESULT_NO_SUCH_METHOD;
+
+        NPObject *commands = NPVARIANT_TO_OBJECT(args[0]);
+        int32_t count = arrayLength(_instance, commands);
+
+        NPObject *window = NULL;
+        if( NPERR_NO_ERROR != NPN_GetValue(_instance, NPNVWindowNPObject, &window) )
+            return INVOKERESULT_GENERIC_ERROR;
+
+        char script[128];
+        snprintf(script, sizeof(script),
+                 "(function(n){for(var a=[],i=0;i<n;i++)a.push({});return a})(%d)",
+                 (int)count);
+        NPString s;
+        s.UTF8Characters = script;
+        s.UTF8Length = strlen(script);
+        NPVariant records;
+        bool b = NPN_Evaluate(_instance, window, &s, &records);
+        NPN_ReleaseObject(window);
+        if( !b )
+            return INVOKERESULT_GENERIC_ERROR;
+        if( !NPVARIANT_IS_OBJECT(records) )
+        {
+            NPN_ReleaseVariantValue(&records);
+            return INVOKERESULT_GENERIC_ERROR;
+        }
+
+        NPIdentifier valueId = NPN_GetStringIdentifier("value");
+        NPIdentifier errorId = NPN_GetStringIdentifier("error");
+        for( int32_t i = 0; i < count; ++i )
+        {
+            NPVariant command, record, value;
+            VOID_TO_NPVARIANT(value);
+            arrayElement(_instance, commands, i, &command);
+            InvokeResult r = NPVARIANT_IS_OBJECT(command)
+                           ? execCommand(NPVARIANT_TO_OBJECT(command), value)
+                           : INVOKERESULT_INVALID_ARGS;
+            NPN_ReleaseVariantValue(&command);
+
+            if( arrayElement(_instance, NPVARIANT_TO_OBJECT(records), i, &record) &&
+                NPVARIANT_IS_OBJECT(record) )
+            {
+                if( r == INVOKERESULT_NO_ERROR )
+                    NPN_SetProperty(_instance, NPVARIANT_TO_OBJECT(record),
+                                    valueId, &value);
+                else
+                {
+                    const char *msg = invokeResultMessage(r);
+                    NPVariant error;
+                    STRINGZ_TO_NPVARIANT(msg ? msg : "Command failed", error);
+                    NPN_SetProperty(_instance, NPVARIANT_TO_OBJECT(record),
+                                    errorId, &error);
+                }
+            }
+            NPN_ReleaseVariantValue(&record);
+            NPN_ReleaseVariantValue(&value);
+        }
+
+        result = records;
+        return INVOKERESULT_NO_ERROR;
+    }
+
+    case ID_root_reseteventlatency:
+        if( 0 != argCount )
+            return INVOKERESULT_NO_SUCH_METHOD;
+        getPrivate<VlcPluginBase>()->events.reset_latency();
+        VOID_TO_NPVARIANT(result);
+        return INVOKERESULT_NO_ERROR;
+
+    /* callback(records), records being an array of
+     * {type, value, timestamp} objects */
+    case ID_root_addbatchlistener:
+    case ID_root_removebatchlistener:
+    {
+        if( (1 != argCount) || !NPVARIANT_IS_OBJECT(args[0]) )
+            break;
+
+        if( !VlcPluginBase::canUseEventListener() )
+        {
+            NPN_SetException(this, ERROR_API_VERSION);
+            return INVOKERESULT_GENERIC_ERROR;
+        }
+
+        VlcPluginBase* p_plugin = getPrivate<VlcPluginBase>();
+        NPObject *listener = NPVARIANT_TO_OBJECT(args[0]);
+
+        bool b;
+        if( ID_root_addbatchlistener == index )
+        {
+            NPN_RetainObject( listener );
+            b = p_plugin->events.insert_batch( listener );
+            if( !b )
+                NPN_ReleaseObject( listener );
+        }
+        else
+        {
+            b = p_plugin->events.remove_batch( listener );
+            if( b )
+                NPN_ReleaseObject( listener );
+        }
+        VOID_TO_NPVARIANT(result);
+
+        return b ? INVOKERESULT_NO_ERROR : INVOKERESULT_GENERIC_ERROR;
+    }
+
     case ID_root_addeventlistener:
     case ID_root_removeeventlistener:
-        if( (3 != argCount) ||
+        /* addEventListener(name, listener, bubble, {maxRate, minDelta}) */
+        if( (3 != argCount &&
+             (4 != argCount || ID_root_addeventlistener != index)) ||
             !NPVARIANT_IS_STRING(args[0]) ||
             !NPVARIANT_IS_OBJECT(args[1]) ||
             !NPVARIANT_IS_BOOLEAN(args[2]) )
@@ -207,10 +494,32 @@ RuntimeNPObject::InvokeResult LibvlcRootNPObject::invoke(int index,
         bool b;
         if( ID_root_addeventlistener == index )
         {
+            double max_rate = 0, min_delta = 0;
+            if( 4 == argCount && NPVARIANT_IS_OBJECT(args[3]) )
+            {
+                NPObject *options = NPVARIANT_TO_OBJECT(args[3]);
+                NPVariant value;
+                if( NPN_GetProperty(_instance, options,
+                        NPN_GetStringIdentifier("maxRate"), &value) )
+                {
+                    if( isNumberValue(value) )
+                        max_rate = doubleValue(value);
+                    NPN_ReleaseVariantValue(&value);
+                }
+                if( NPN_GetProperty(_instance, options,
+                        NPN_GetStringIdentifier("minDelta"), &value) )
+                {
+                    if( isNumberValue(value) )
+                        min_delta = doubleValue(value);
+                    NPN_ReleaseVariantValue(&value);
+                }
+            }
+
             NPN_RetainObject( NPVARIANT_TO_OBJECT(args[1]) );
             b = p_plugin->events.insert( NPVARIANT_TO_STRING(args[0]),
                                          NPVARIANT_TO_OBJECT(args[1]),
-                                         NPVARIANT_TO_BOOLEAN(args[2]) );
+                                         NPVARIANT_TO_BOOLEAN(args[2]),
+                                         max_rate, min_delta );
             if( !b )
                 NPN_ReleaseObject( NPVARIANT_TO_OBJECT(args[1]) );
         }
@@ -517,35 +826,39 @@ LibvlcInputNPObject::getProperty(int index, NPVariant &result)
             }
         }
 
+        /* kept up to date by the media player events, reading it never
+         * waits for the input thread */
+        vlc_player_state state = p_plugin->player_state();
+
         switch( index )
         {
             case ID_input_length:
             {
-                double val = (double)libvlc_media_player_get_length(p_md);
+                double val = (double)state.length;
                 DOUBLE_TO_NPVARIANT(val, result);
                 return INVOKERESULT_NO_ERROR;
             }
             case ID_input_position:
             {
-                double val = libvlc_media_player_get_position(p_md);
+                double val = state.position;
                 DOUBLE_TO_NPVARIANT(val, result);
                 return INVOKERESULT_NO_ERROR;
             }
             case ID_input_time:
             {
-                double val = (double)libvlc_media_player_get_time(p_md);
+                double val = (double)state.time;
                 DOUBLE_TO_NPVARIANT(val, result);
                 return INVOKERESULT_NO_ERROR;
             }
             case ID_input_state:
             {
-                int val = libvlc_media_player_get_state(p_md);
+                int val = state.state;
                 INT32_TO_NPVARIANT(val, result);
                 return INVOKERESULT_NO_ERROR;
             }
             case ID_input_rate:
             {
-                float val = libvlc_media_player_get_rate(p_md);
+                float val = state.rate;
                 DOUBLE_TO_NPVARIANT(val, result);
                 return INVOKERESULT_NO_ERROR;
             }
@@ -589,7 +902,7 @@ LibvlcInputNPObject::setProperty(int index, const NPVariant &value)
                 }
 
                 float val = (float)doubleValue(value);
-                libvlc_media_player_set_position(p_md, val);
+                p_plugin->player_set_position(val);
                 return INVOKERESULT_NO_ERROR;
             }
             case ID_input_time:
@@ -600,7 +913,7 @@ LibvlcInputNPObject::setProperty(int index, const NPVariant &value)
                 }
 
                 int64_t val = (int64_t)intValue(value);
-                libvlc_media_player_set_time(p_md, val);
+                p_plugin->player_set_time(val);
                 return INVOKERESULT_NO_ERROR;
             }
             case ID_input_rate:
@@ -611,7 +924,7 @@ LibvlcInputNPObject::setProperty(int index, const NPVariant &value)
                 }
 
                 float val = (float)doubleValue(value);
-                libvlc_media_player_set_rate(p_md, val);
+                p_plugin->player_set_rate(val);
                 return INVOKERESULT_NO_ERROR;
             }
             default:
@@ -623,27 +936,101 @@ LibvlcInputNPObject::setProperty(int index, const NPVariant &value)
 
 const NPUTF8 * const LibvlcInputNPObject::methodNames[] =
 {
-    /* no methods */
-    "none",
+    "snapshot",
 };
 COUNTNAMES(LibvlcInputNPObject,methodCount,methodNames);
 
 enum LibvlcInputNPObjectMethodIds
 {
-    ID_none,
+    ID_input_snapshot,
+};
+
+/* fields of the object returned by snapshot() */
+static const NPUTF8 * const snapshotNames[] =
+{
+    "time",
+    "length",
+    "position",
+    "state",
+    "rate",
+    "volume",
+    "seekable",
+    "pausable",
 };
 
 RuntimeNPObject::InvokeResult
-LibvlcInputNPObject::invoke(int index, const NPVariant *,
-                            uint32_t, NPVariant &)
+LibvlcInputNPObject::invoke(int index, const NPVariant *args,
+                            uint32_t argCount, NPVariant &result)
 {
     /* is plugin still running */
     if( isPluginRunning() )
     {
+        VlcPluginBase* p_plugin = getPrivate<VlcPluginBase>();
+        libvlc_media_player_t *p_md = p_plugin->getMD();
+        if( !p_md )
+            RETURN_ON_ERROR;
+
         switch( index )
         {
-            case ID_none:
-                return INVOKERESULT_NO_SUCH_METHOD;
+            /* snapshot([object]): the playback state in one call, into
+             * object if given, else into a new one */
+            case ID_input_snapshot:
+            {
+                if( argCount > 1 ||
+                    (argCount == 1 && !NPVARIANT_IS_OBJECT(args[0])) )
+                    return INVOKERESULT_NO_SUCH_METHOD;
+
+                vlc_player_state state = p_plugin->player_state();
+                NPVariant values[ARRAY_SIZE(snapshotNames)];
+                DOUBLE_TO_NPVARIANT((double)state.time, values[0]);
+                DOUBLE_TO_NPVARIANT((double)state.length, values[1]);
+                DOUBLE_TO_NPVARIANT(state.position, values[2]);
+                INT32_TO_NPVARIANT(state.state, values[3]);
+                DOUBLE_TO_NPVARIANT(state.rate, values[4]);
+                INT32_TO_NPVARIANT(libvlc_audio_get_volume(p_md), values[5]);
+                BOOLEAN_TO_NPVARIANT(state.seekable, values[6]);
+                BOOLEAN_TO_NPVARIANT(state.pausable, values[7]);
+
+                NPObject *obj = NULL;
+                if( argCount == 1 )
+                    obj = NPN_RetainObject(NPVARIANT_TO_OBJECT(args[0]));
+                else
+                {
+                    NPObject *window = NULL;
+                    if( NPERR_NO_ERROR != NPN_GetValue(_instance, NPNVWindowNPObject, &window) )
+                        return INVOKERESULT_GENERIC_ERROR;
+
+                    NPString script;
+                    script.UTF8Characters = "({})";
+                    script.UTF8Length = 4;
+                    NPVariant created;
+                    bool b = NPN_Evaluate(_instance, window, &script, &created);
+                    NPN_ReleaseObject(window);
+                    if( !b )
+                        return INVOKERESULT_GENERIC_ERROR;
+                    if( !NPVARIANT_IS_OBJECT(created) )
+                    {
+                        NPN_ReleaseVariantValue(&created);
+                        return INVOKERESULT_GENERIC_ERROR;
+                    }
+                    obj = NPVARIANT_TO_OBJECT(created);
+                }
+
+                /* identifiers live as long as the browser */
+                static NPIdentifier ids[ARRAY_SIZE(snapshotNames)];
+                static bool ids_ready = false;
+                if( !ids_ready )
+                {
+                    NPN_GetStringIdentifiers(const_cast<const NPUTF8**>(snapshotNames),
+                        ARRAY_SIZE(snapshotNames), ids);
+                    ids_ready = true;
+                }
+                for( size_t i = 0; i < ARRAY_SIZE(snapshotNames); i++ )
+                    NPN_SetProperty(_instance, obj, ids[i], &values[i]);
+
+                OBJECT_TO_NPVARIANT(obj, result);
+                return INVOKERESULT_NO_ERROR;
+            }
             default:
                 ;
         }
@@ -1043,13 +1430,13 @@ LibvlcPlaylistNPObject::invoke(int index, const NPVariant *args,
                 }
                 return INVOKERESULT_NO_SUCH_METHOD;
             case ID_playlist_playItem:
-                if( (argCount == 1) && isNumberValue(args[0]) )
-                {
-                    p_plugin->playlist_play_item(intValue(args[0]));
-                    VOID_TO_NPVARIANT(result);
-                    return INVOKERESULT_NO_ERROR;
-                }
-                return INVOKERESULT_NO_SUCH_METHOD;
+            {
+                Method<void(int)> m;
+                if( !m.bind(args, argCount) )
+                    return INVOKERESULT_NO_SUCH_METHOD;
+                p_plugin->playlist_play_item(m.arg1);
+                return m.result(result);
+            }
             case ID_playlist_pause:
                 if( argCount == 0 )
                 {
@@ -1459,6 +1846,9 @@ const NPUTF8 * const LibvlcVideoNPObject::propertyNames[] =
     "marquee",
     "logo",
     "deinterlace",
+    "framesDisplayed",
+    "framesCoalesced",
+    "invalidatesCoalesced",
 };
 
 enum LibvlcVideoNPObjectPropertyIds
@@ -1473,6 +1863,9 @@ enum LibvlcVideoNPObjectPropertyIds
     ID_video_marquee,
     ID_video_logo,
     ID_video_deinterlace,
+    ID_video_framesdisplayed,
+    ID_video_framescoalesced,
+    ID_video_invalidatescoalesced,
 };
 COUNTNAMES(LibvlcVideoNPObject,propertyCount,propertyNames);
 
@@ -1557,6 +1950,21 @@ LibvlcVideoNPObject::getProperty(int index, NPVariant &result)
                 OBJECT_TO_NPVARIANT(NPN_RetainObject(deintObj), result);
                 return INVOKERESULT_NO_ERROR;
             }
+            case ID_video_framesdisplayed:
+            {
+                INT32_TO_NPVARIANT(p_plugin->get_frames_displayed(), result);
+                return INVOKERESULT_NO_ERROR;
+            }
+            case ID_video_framescoalesced:
+            {
+                INT32_TO_NPVARIANT(p_plugin->get_frames_coalesced(), result);
+                return INVOKERESULT_NO_ERROR;
+            }
+            case ID_video_invalidatescoalesced:
+            {
+                INT32_TO_NPVARIANT(p_plugin->get_invalidates_coalesced(), result);
+                return INVOKERESULT_NO_ERROR;
+            }
         }
     }
     return INVOKERESULT_GENERIC_ERROR;
@@ -1588,21 +1996,19 @@ LibvlcVideoNPObject::setProperty(int index, const NPVariant &value)
             }
             case ID_video_aspectratio:
             {
-                char *psz_aspect = NULL;
+                NPCString aspect;
 
                 if( ! NPVARIANT_IS_STRING(value) )
                 {
                     return INVOKERESULT_INVALID_VALUE;
                 }
 
-                psz_aspect = stringValue(NPVARIANT_TO_STRING(value));
-                if( !psz_aspect )
+                if( !NPArg<const char *>::get(value, aspect) )
                 {
                     return INVOKERESULT_GENERIC_ERROR;
                 }
 
-                libvlc_video_set_aspect_ratio(p_md, psz_aspect);
-                free(psz_aspect);
+                libvlc_video_set_aspect_ratio(p_md, aspect);
 
                 return INVOKERESULT_NO_ERROR;
             }
@@ -1618,21 +2024,19 @@ LibvlcVideoNPObject::setProperty(int index, const NPVariant &value)
             }
             case ID_video_crop:
             {
-                char *psz_geometry = NULL;
+                NPCString geometry;
 
                 if( ! NPVARIANT_IS_STRING(value) )
                 {
                     return INVOKERESULT_INVALID_VALUE;
                 }
 
-                psz_geometry = stringValue(NPVARIANT_TO_STRING(value));
-                if( !psz_geometry )
+                if( !NPArg<const char *>::get(value, geometry) )
                 {
                     return INVOKERESULT_GENERIC_ERROR;
                 }
 
-                libvlc_video_set_crop_geometry(p_md, psz_geometry);
-                free(psz_geometry);
+                libvlc_video_set_crop_geometry(p_md, geometry);
 
                 return INVOKERESULT_NO_ERROR;
             }
@@ -1833,16 +2237,17 @@ LibvlcMarqueeNPObject::setProperty(int index, const NPVariant &value)
         return INVOKERESULT_NO_ERROR;
 
     case ID_marquee_text:
-        if( NPVARIANT_IS_STRING( value ) )
+    {
+        NPCString text;
+        if( NPArg<const char *>::get( value, text ) )
         {
-            char *psz_text = stringValue( NPVARIANT_TO_STRING( value ) );
             libvlc_video_set_marquee_string(p_md, libvlc_marquee_Text,
-                                            psz_text);
-            free(psz_text);
+                                            text);
             return INVOKERESULT_NO_ERROR;
         }
         break;
     }
+    }
     return INVOKERESULT_NO_SUCH_METHOD;
 }
 
@@ -2091,8 +2496,6 @@ RuntimeNPObject::InvokeResult
 LibvlcDeinterlaceNPObject::invoke(int index, const NPVariant *args,
                                   uint32_t argCount, NPVariant &)
 {
-    char *psz;
-
     if( !isPluginRunning() )
         return INVOKERESULT_GENERIC_ERROR;
 
@@ -2107,13 +2510,14 @@ LibvlcDeinterlaceNPObject::invoke(int index, const NPVariant *args,
         break;
 
     case ID_deint_enable:
-        if( argCount != 1 || !NPVARIANT_IS_STRING( args[0] ) )
+    {
+        Method<void(const char *)> m;
+        if( !m.bind( args, argCount ) )
             return INVOKERESULT_INVALID_VALUE;
 
-        psz = stringValue( NPVARIANT_TO_STRING( args[0] ) );
-        libvlc_video_set_deinterlace(p_md, psz);
-        free(psz);
+        libvlc_video_set_deinterlace(p_md, m.arg1);
         break;
+    }
 
     default:
         return INVOKERESULT_NO_SUCH_METHOD;
@@ -26,6 +26,7 @@
 ** defined runtime script objects
 */
 #include <vlc/vlc.h>
+#include <string>
 
 #include "nporuntime.h"
 
@@ -56,6 +57,9 @@ protected:
     InvokeResult invoke(int index, const NPVariant *args, uint32_t argCount, NPVariant &result);
 
 private:
+    InvokeResult resolveTarget(const std::string &path, RuntimeNPObject **target);
+    InvokeResult execCommand(NPObject *command, NPVariant &value);
+
     NPObject *audioObj;
     NPObject *inputObj;
     NPObject *playlistObj;
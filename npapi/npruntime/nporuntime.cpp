@@ -32,6 +32,65 @@
 
 #include "nporuntime.h"
 
+#include <vector>
+
+/* every RuntimeNPClass<T> singleton, they are never destroyed */
+static std::vector<const NPClass *> &runtimeClasses()
+{
+    static std::vector<const NPClass *> classes;
+    return classes;
+}
+
+RuntimeNPClassBase::RuntimeNPClassBase()
+{
+    runtimeClasses().push_back(this);
+}
+
+bool RuntimeNPClassBase::isRuntimeObject(const NPObject *npobj)
+{
+    const std::vector<const NPClass *> &classes = runtimeClasses();
+    for( size_t i = 0; i < classes.size(); ++i )
+    {
+        if( classes[i] == npobj->_class )
+            return true;
+    }
+    return false;
+}
+
+void RuntimeNPIdentifierTable::init(const NPUTF8 * const names[], int count)
+{
+    if( count <= 0 )
+        return;
+
+    NPIdentifier *ids = new NPIdentifier[count];
+    NPN_GetStringIdentifiers(const_cast<const NPUTF8**>(names), count, ids);
+
+    // at most half full, a lookup rarely probes more than one slot
+    size_t size = 4;
+    while( size < 2 * (size_t)count )
+        size *= 2;
+    _slots = new Slot[size];
+    _mask = size - 1;
+    for( size_t i = 0; i < size; ++i )
+        _slots[i].id = NULL;
+
+    for( int c = 0; c < count; ++c )
+    {
+        if( !ids[c] )
+            continue;
+        size_t i = hash(ids[c]) & _mask;
+        while( _slots[i].id && _slots[i].id != ids[c] )
+            i = (i + 1) & _mask;
+        // on duplicate names the first one wins, as with a linear scan
+        if( !_slots[i].id )
+        {
+            _slots[i].id = ids[c];
+            _slots[i].index = c;
+        }
+    }
+    delete[] ids;
+}
+
 char* RuntimeNPObject::stringValue(const NPString &s)
 {
     NPUTF8 *val = static_cast<NPUTF8*>(malloc((s.UTF8Length+1) * sizeof(*val)));
@@ -84,27 +143,31 @@ RuntimeNPObject::InvokeResult RuntimeNPObject::invokeDefault(const NPVariant *,
     return INVOKERESULT_NO_ERROR;
 }
 
-bool RuntimeNPObject::returnInvokeResult(RuntimeNPObject::InvokeResult result)
+const char *RuntimeNPObject::invokeResultMessage(RuntimeNPObject::InvokeResult result)
 {
     switch( result )
     {
-        case INVOKERESULT_NO_ERROR:
-            return true;
-        case INVOKERESULT_GENERIC_ERROR:
-            break;
         case INVOKERESULT_NO_SUCH_METHOD:
-            NPN_SetException(this, "No such method or arguments mismatch");
-            break;
+            return "No such method or arguments mismatch";
         case INVOKERESULT_INVALID_ARGS:
-            NPN_SetException(this, "Invalid arguments");
-            break;
+            return "Invalid arguments";
         case INVOKERESULT_INVALID_VALUE:
-            NPN_SetException(this, "Invalid value in assignment");
-            break;
+            return "Invalid value in assignment";
         case INVOKERESULT_OUT_OF_MEMORY:
-            NPN_SetException(this, "Out of memory");
-            break;
+            return "Out of memory";
+        default:
+            return NULL;
     }
+}
+
+bool RuntimeNPObject::returnInvokeResult(RuntimeNPObject::InvokeResult result)
+{
+    if( result == INVOKERESULT_NO_ERROR )
+        return true;
+
+    const char *msg = invokeResultMessage(result);
+    if( msg )
+        NPN_SetException(this, msg);
     return false;
 }
 
@@ -37,6 +37,52 @@
 #include <npruntime.h>
 #include <stdlib.h>
 
+/*
+** identifiers of a script class, hashed by their NPIdentifier
+** (an opaque pointer) into an open addressing table
+*/
+class RuntimeNPIdentifierTable
+{
+public:
+    RuntimeNPIdentifierTable() : _slots(NULL), _mask(0) {};
+    ~RuntimeNPIdentifierTable() { delete[] _slots; };
+
+    void init(const NPUTF8 * const names[], int count);
+
+    // index of name in names, or -1
+    int indexOf(NPIdentifier name) const
+    {
+        if( !_slots || !name )
+            return -1;
+        for( size_t i = hash(name) & _mask; _slots[i].id; i = (i + 1) & _mask )
+        {
+            if( _slots[i].id == name )
+                return _slots[i].index;
+        }
+        return -1;
+    };
+
+private:
+    struct Slot
+    {
+        NPIdentifier id; // NULL for an empty slot
+        int index;
+    };
+
+    static size_t hash(NPIdentifier name)
+    {
+        // identifiers are aligned pointers, mix the upper bits down
+        size_t h = reinterpret_cast<size_t>(name);
+        h ^= h >> 16;
+        h *= 0x45d9f3b;
+        h ^= h >> 16;
+        return h;
+    };
+
+    Slot *_slots;
+    size_t _mask;
+};
+
 static void RuntimeNPClassDeallocate(NPObject *npobj);
 static void RuntimeNPClassInvalidate(NPObject *npobj);
 static bool RuntimeNPClassInvokeDefault(NPObject *npobj,
@@ -138,6 +184,8 @@ public:
     virtual InvokeResult invokeDefault(const NPVariant *args, uint32_t argCount, NPVariant &result);
 
     bool returnInvokeResult(InvokeResult result);
+    // exception message of a result, NULL for none
+    static const char *invokeResultMessage(InvokeResult result);
 
     static InvokeResult invokeResultString(const char *,NPVariant &);
 
@@ -189,7 +237,33 @@ protected:
     NPP _instance;
 };
 
-template<class T> class RuntimeNPClass : public NPClass
+/*
+** identifier lookup of RuntimeNPClass<T>, which does not depend on T
+*/
+class RuntimeNPClassBase : public NPClass
+{
+public:
+    // true if npobj was created by one of our classes, and not by the
+    // browser or another plugin
+    static bool isRuntimeObject(const NPObject *npobj);
+
+    int indexOfMethod(NPIdentifier name) const
+    {
+        return methodIdentifiers.indexOf(name);
+    };
+    int indexOfProperty(NPIdentifier name) const
+    {
+        return propertyIdentifiers.indexOf(name);
+    };
+
+protected:
+    RuntimeNPClassBase();
+
+    RuntimeNPIdentifierTable propertyIdentifiers;
+    RuntimeNPIdentifierTable methodIdentifiers;
+};
+
+template<class T> class RuntimeNPClass : public RuntimeNPClassBase
 {
 public:
     static NPClass *getClass()
@@ -213,13 +287,6 @@ protected:
                                                                       NPVariant *result);
 
     RuntimeNPObject *create(NPP instance) const;
-
-    int indexOfMethod(NPIdentifier name) const;
-    int indexOfProperty(NPIdentifier name) const;
-
-private:
-    NPIdentifier *propertyIdentifiers;
-    NPIdentifier *methodIdentifiers;
 };
 
 template<class T>
@@ -346,23 +413,10 @@ static bool RuntimeNPClassInvokeDefault(NPObject *npobj,
 template<class T>
 RuntimeNPClass<T>::RuntimeNPClass()
 {
-    // retreive property identifiers from names
-    if( T::propertyCount > 0 )
-    {
-        propertyIdentifiers = new NPIdentifier[T::propertyCount];
-        if( propertyIdentifiers )
-            NPN_GetStringIdentifiers(const_cast<const NPUTF8**>(T::propertyNames),
-                T::propertyCount, propertyIdentifiers);
-    }
-
-    // retreive method identifiers from names
-    if( T::methodCount > 0 )
-    {
-        methodIdentifiers = new NPIdentifier[T::methodCount];
-        if( methodIdentifiers )
-            NPN_GetStringIdentifiers(const_cast<const NPUTF8**>(T::methodNames),
-                T::methodCount, methodIdentifiers);
-    }
+    // retreive property and method identifiers from names, the
+    // browser calls has* then get*/invoke for each script access
+    propertyIdentifiers.init(T::propertyNames, T::propertyCount);
+    methodIdentifiers.init(T::methodNames, T::methodCount);
 
     // fill in NPClass structure
     structVersion  = NP_CLASS_STRUCT_VERSION;
@@ -383,8 +437,6 @@ RuntimeNPClass<T>::RuntimeNPClass()
 template<class T>
 RuntimeNPClass<T>::~RuntimeNPClass()
 {
-    delete[] propertyIdentifiers;
-    delete[] methodIdentifiers;
 }
 
 template<class T>
@@ -393,32 +445,4 @@ RuntimeNPObject *RuntimeNPClass<T>::create(NPP instance) const
     return new T(instance, this);
 }
 
-template<class T>
-int RuntimeNPClass<T>::indexOfMethod(NPIdentifier name) const
-{
-    if( methodIdentifiers )
-    {
-        for(int c=0; c< T::methodCount; ++c )
-        {
-            if( name == methodIdentifiers[c] )
-                return c;
-        }
-    }
-    return -1;
-}
-
-template<class T>
-int RuntimeNPClass<T>::indexOfProperty(NPIdentifier name) const
-{
-    if( propertyIdentifiers )
-    {
-        for(int c=0; c< T::propertyCount; ++c )
-        {
-            if( name == propertyIdentifiers[c] )
-                return c;
-        }
-    }
-    return -1;
-}
-
 #endif
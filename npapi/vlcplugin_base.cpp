@@ -55,7 +55,8 @@ VlcPluginBase::VlcPluginBase( NPP instance, NPuint16_t mode ) :
     libvlc_instance(NULL),
     p_scriptClass(NULL),
     p_browser(instance),
-    psz_baseURL(NULL)
+    psz_baseURL(NULL),
+    events_scheduled(0)
 {
     memset(&npwindow, 0, sizeof(NPWindow));
     _instances.insert(this);
@@ -76,16 +77,20 @@ void VlcPluginBase::eventAsync(void *param)
     if( _instances.find(plugin) == _instances.end() )
         return;
 
+    // cleared first: events queued from now on need another call
+    plugin_atomic_swap(&plugin->events_scheduled, 0);
     plugin->events.deliver(plugin->getBrowser());
     plugin->update_controls();
 }
 
 void VlcPluginBase::event_callback(const libvlc_event_t* event,
-                NPVariant *npparams, uint32_t npcount)
+                const NPVariant *npparams, uint32_t npcount)
 {
 #if defined(XP_UNIX) || defined(XP_WIN) || defined (XP_MACOSX)
     events.callback(event, npparams, npcount);
-    NPN_PluginThreadAsyncCall(getBrowser(), eventAsync, this);
+    // a burst of events is delivered by a single call
+    if( plugin_atomic_cas(&events_scheduled, 0, 1) )
+        NPN_PluginThreadAsyncCall(getBrowser(), eventAsync, this);
 #else
 #   warning NPN_PluginThreadAsyncCall not implemented yet.
     printf("No NPN_PluginThreadAsyncCall(), doing nothing.\n");
@@ -197,6 +202,30 @@ NPError VlcPluginBase::init(int argc, char* const argn[], char* const argv[])
         {
             set_enable_branding( boolValue(argv[i]) );
         }
+        else if( !strcmp( argn[i], "framebuffers" ) )
+        {
+            int fb = atoi( argv[i] );
+            if( fb > 0 )
+                set_frame_buffers( fb );
+        }
+        else if( !strcmp( argn[i], "chroma" ) )
+        {
+            set_video_chroma( argv[i] );
+        }
+        else if( !strcmp( argn[i], "colormatrix" ) )
+        {
+            set_yuv_matrix( argv[i] );
+        }
+        else if( !strcmp( argn[i], "fullrange" ) )
+        {
+            set_full_range( boolValue(argv[i]) );
+        }
+        else if( !strcmp( argn[i], "videothreads" ) )
+        {
+            int vt = atoi( argv[i] );
+            if( vt >= 0 )
+                set_video_threads( vt );
+        }
     }
 
     libvlc_instance = libvlc_new(ppsz_argc, ppsz_argv);
@@ -256,12 +285,8 @@ NPError VlcPluginBase::init(int argc, char* const argn[], char* const argv[])
     /* new APIs */
     p_scriptClass = RuntimeNPClass<LibvlcRootNPObject>::getClass();
 
-    libvlc_media_player_t *p_md = getMD();
-    if( p_md ) {
-      libvlc_event_manager_t *p_em;
-      p_em = libvlc_media_player_event_manager( getMD() );
-      events.hook_manager( p_em, this );
-    }
+    if( getMD() )
+      events.hook_manager( this, this, controls_use_events() );
 
     return NPERR_NO_ERROR;
 }
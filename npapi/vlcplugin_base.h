@@ -159,6 +159,22 @@ public:
     void control_handler(vlc_toolbar_clicked_t);
 
     bool  player_has_vout();
+    vlc_player_state player_state() const
+    {
+        return get_cached_state();
+    }
+    void player_set_rate(float rate)
+    {
+        set_rate(rate);
+    }
+    void player_set_position(float position)
+    {
+        set_position(position);
+    }
+    void player_set_time(libvlc_time_t time)
+    {
+        set_time(time);
+    }
 
     virtual bool create_windows() = 0;
     virtual bool resize_windows() = 0;
@@ -178,14 +194,22 @@ public:
     virtual bool get_toolbar_visible() = 0;
 
     virtual void update_controls() = 0;
+    // true if update_controls() relies on player events: they are then
+    // all hooked, even without script listeners
+    virtual bool controls_use_events() { return false; }
     virtual void popup_menu() = 0;
 
     virtual void set_player_window() = 0;
 
+    // windowless video statistics
+    virtual unsigned get_frames_displayed()      { return 0; }
+    virtual unsigned get_frames_coalesced()      { return 0; }
+    virtual unsigned get_invalidates_coalesced() { return 0; }
+
     static bool canUseEventListener();
 
     EventObj events;
-    void event_callback(const libvlc_event_t *, NPVariant *, uint32_t);
+    void event_callback(const libvlc_event_t *, const NPVariant *, uint32_t);
 
 protected:
     // called after libvlc_media_player_new_from_media
@@ -205,6 +229,7 @@ protected:
     NPWindow  npwindow;
 
     static void eventAsync(void *);
+    plugin_atomic_t events_scheduled; /* an eventAsync() call is pending */
 
 private:
     static std::set<VlcPluginBase*> _instances;
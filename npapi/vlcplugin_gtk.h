@@ -49,6 +49,7 @@ public:
     void set_toolbar_visible(bool);
     bool get_toolbar_visible();
     void update_controls();
+    bool controls_use_events() { return true; }
     void popup_menu();
 
     void resize_video_xwindow(GdkRectangle *rect);
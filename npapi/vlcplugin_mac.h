@@ -47,6 +47,7 @@ public:
     void set_toolbar_visible(bool);
     bool get_toolbar_visible();
     void update_controls();
+    bool controls_use_events() { return true; }
     void popup_menu()           {/* STUB */}
 
     bool handle_event(void *event);
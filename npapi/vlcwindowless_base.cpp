@@ -24,62 +24,416 @@
  *****************************************************************************/
 
 #include "vlcwindowless_base.h"
+#include "vlcwindowless_scale.h"
+
+#include <cstdlib>
 
 VlcWindowlessBase::VlcWindowlessBase(NPP instance, NPuint16_t mode) :
-    VlcPluginBase(instance, mode), m_media_width(0), m_media_height(0)
+    VlcPluginBase(instance, mode), m_media_width(0), m_media_height(0),
+    m_frames(MAX_FRAME_BUFFERS + SPARE_FRAME_BUFFERS + SCALED_FRAME_BUFFERS),
+    m_frame_seq(0), m_lock_seq(0), m_displayed_lock_seq(0),
+    m_painting(false), m_planar(false),
+    m_invalidate_pending(0), m_frames_displayed(0), m_frames_coalesced(0),
+    m_invalidates_coalesced(0), m_out_width(0), m_out_height(0),
+    m_req_width(0), m_req_height(0), m_req_time(0),
+    m_invalidated_width(0), m_invalidated_height(0)
 {
+    memset(&m_frames[0], 0, sizeof(FrameBuffer) * m_frames.size());
+    for( size_t i = MAX_FRAME_BUFFERS + SPARE_FRAME_BUFFERS;
+         i < m_frames.size(); ++i )
+        m_frames[i].scaled = true;
+    plugin_lock_init(&m_frames_lock);
 }
 
-unsigned VlcWindowlessBase::video_format_cb(char *chroma,
-                                unsigned *width, unsigned *height,
-                                unsigned *pitches, unsigned *lines)
+VlcWindowlessBase::~VlcWindowlessBase()
+{
+    release_frame_pool();
+    plugin_lock_destroy(&m_frames_lock);
+}
+
+bool VlcWindowlessBase::alloc_frame_buf(FrameBuffer &fb, size_t size)
+{
+    fb.alloc = malloc(size + FRAME_BUF_ALIGN - 1);
+    if( !fb.alloc )
+        return false;
+
+    uintptr_t p = reinterpret_cast<uintptr_t>(fb.alloc);
+    p = (p + FRAME_BUF_ALIGN - 1) & ~(uintptr_t)(FRAME_BUF_ALIGN - 1);
+    fb.data = reinterpret_cast<char *>(p);
+    fb.size = size;
+    return true;
+}
+
+void VlcWindowlessBase::free_frame_buf(FrameBuffer &fb)
+{
+    free(fb.alloc);
+    fb.alloc = 0;
+    fb.data = 0;
+    fb.size = 0;
+}
+
+void VlcWindowlessBase::release_frame_pool()
+{
+    plugin_lock(&m_frames_lock);
+    for( size_t i = 0; i < m_frames.size(); ++i ) {
+        if( m_frames[i].alloc )
+            free_frame_buf(m_frames[i]);
+        m_frames[i].state = FrameBuffer::Free;
+        m_frames[i].retired = false;
+    }
+    plugin_unlock(&m_frames_lock);
+}
+
+void VlcWindowlessBase::fit_size(unsigned *width, unsigned *height,
+                                 unsigned box_width, unsigned box_height)
 {
-    if ( p_browser ) {
-        float src_aspect = (float)(*width) / (*height);
-        float dst_aspect = (float)npwindow.width/npwindow.height;
-        if ( src_aspect > dst_aspect ) {
-            if( npwindow.width != (*width) ) { //don't scale if size equal
-                (*width) = npwindow.width;
-                (*height) = static_cast<unsigned>( (*width) / src_aspect + 0.5);
-            }
+    if( !*width || !*height || !box_width || !box_height )
+        return;
+
+    float src_aspect = (float)(*width) / (*height);
+    float dst_aspect = (float)box_width / box_height;
+    if ( src_aspect > dst_aspect ) {
+        if( box_width != (*width) ) { //don't scale if size equal
+            (*width) = box_width;
+            (*height) = static_cast<unsigned>( (*width) / src_aspect + 0.5);
         }
-        else {
-            if( npwindow.height != (*height) ) { //don't scale if size equal
-                (*height) = npwindow.height;
-                (*width) = static_cast<unsigned>( (*height) * src_aspect + 0.5);
-            }
+    }
+    else {
+        if( box_height != (*height) ) { //don't scale if size equal
+            (*height) = box_height;
+            (*width) = static_cast<unsigned>( (*height) * src_aspect + 0.5);
         }
     }
+}
+
+void VlcWindowlessBase::setWindow(const NPWindow &window)
+{
+    VlcPluginBase::setWindow(window);
+
+    plugin_lock(&m_frames_lock);
+    if( window.width != m_req_width || window.height != m_req_height ) {
+        m_req_width = window.width;
+        m_req_height = window.height;
+        m_req_time = libvlc_clock();
+    }
+    plugin_unlock(&m_frames_lock);
+}
+
+/* size frames of width x height are painted at, called with m_frames_lock
+ * held */
+void VlcWindowlessBase::fit_output_size(unsigned *width, unsigned *height)
+{
+    if( scales_on_present() )
+        return;
+
+    unsigned fit_width = *width, fit_height = *height;
+    fit_size(&fit_width, &fit_height, m_req_width, m_req_height);
+    // the painter enlarges them cheaply, shrinking is done on our side
+    if( fit_width > *width && upscales_on_present() )
+        return;
+    *width = fit_width;
+    *height = fit_height;
+}
+
+/* called with m_frames_lock held, from the libvlc video thread */
+void VlcWindowlessBase::update_output_size()
+{
+    unsigned width = m_media_width, height = m_media_height;
+    fit_output_size(&width, &height);
+    if( width == m_out_width && height == m_out_height )
+        return;
+
+    // debounce: wait for the window to settle
+    if( libvlc_clock() - m_req_time < RESIZE_DEBOUNCE * 1000 )
+        return;
+
+    // hysteresis: ignore small changes, unless we are back to the
+    // native size which needs no scaling at all
+    unsigned dw = width > m_out_width ? width - m_out_width
+                                      : m_out_width - width;
+    unsigned dh = height > m_out_height ? height - m_out_height
+                                        : m_out_height - height;
+    bool native = width == m_media_width && height == m_media_height;
+    if( !native && dw < RESIZE_HYSTERESIS && dh < RESIZE_HYSTERESIS )
+        return;
+
+    m_out_width = width;
+    m_out_height = height;
+}
+
+static unsigned align_pitch(unsigned pitch)
+{
+    return (pitch + FRAME_BUF_ALIGN - 1) & ~(unsigned)(FRAME_BUF_ALIGN - 1);
+}
+
+/* sets the planes of a planar format, returns the number of planes
+ * or 0 if the options ask for RGB frames */
+unsigned VlcWindowlessBase::planar_format(char *chroma,
+                                          unsigned *pitches, unsigned *lines)
+{
+    const std::string &name = get_options().get_video_chroma();
+    yuv_layout_e layout;
+    if( name == "I420" )
+        layout = yuv_layout_i420;
+    else if( name == "NV12" )
+        layout = yuv_layout_nv12;
+    else
+        return 0;
+
+    yuv_matrix_e matrix;
+    const std::string &m = get_options().get_yuv_matrix();
+    if( m == "bt709" )
+        matrix = yuv_matrix_bt709;
+    else if( m == "bt601" )
+        matrix = yuv_matrix_bt601;
+    else // HD content is BT.709, SD is BT.601
+        matrix = m_media_height > 576 ? yuv_matrix_bt709 : yuv_matrix_bt601;
+
+#ifdef XP_MACOSX
+    rgb_order_e order = rgb_order_rgba;
+#else
+    rgb_order_e order = rgb_order_bgra;
+#endif
+    yuv_convert_init(&m_convert, matrix, get_options().get_full_range(),
+                     layout, order);
+
+    memcpy(chroma, name.c_str(), 4);
+    unsigned chroma_width = (m_media_width + 1) / 2;
+    unsigned chroma_height = (m_media_height + 1) / 2;
+
+    // aligned pitches keep every plane aligned for the SIMD kernels
+    pitches[0] = align_pitch(m_media_width);
+    lines[0] = m_media_height;
+    if( layout == yuv_layout_nv12 ) {
+        pitches[1] = align_pitch(chroma_width * 2);
+        lines[1] = chroma_height;
+        return 2;
+    }
+    pitches[1] = pitches[2] = align_pitch(chroma_width);
+    lines[1] = lines[2] = chroma_height;
+    return 3;
+}
+
+unsigned VlcWindowlessBase::video_format_cb(char *chroma,
+                                unsigned *width, unsigned *height,
+                                unsigned *pitches, unsigned *lines)
+{
+    /* vmem can not change its format without restarting the video output,
+     * so frames are requested at their native size (capped) and scaled
+     * down to the current window size on our side, see frame_displayed().
+     * Painters may enlarge them when presenting, see fit_output_size() */
+    if( (*width) > MAX_DECODE_WIDTH || (*height) > MAX_DECODE_HEIGHT )
+        fit_size(width, height, __MIN((*width), (unsigned)MAX_DECODE_WIDTH),
+                                __MIN((*height), (unsigned)MAX_DECODE_HEIGHT));
 
     m_media_width = (*width);
     m_media_height = (*height);
 
-    memcpy(chroma, DEF_CHROMA, sizeof(DEF_CHROMA)-1);
-    (*pitches) = m_media_width * DEF_PIXEL_BYTES;
-    (*lines) = m_media_height;
+    unsigned planes = planar_format(chroma, pitches, lines);
+    m_planar = planes != 0;
+    if( !m_planar ) {
+        memcpy(chroma, DEF_CHROMA, sizeof(DEF_CHROMA)-1);
+        (*pitches) = m_media_width * DEF_PIXEL_BYTES;
+        (*lines) = m_media_height;
+        planes = 1;
+    }
+
+    m_workers.set_threads(get_options().get_video_threads());
 
+    unsigned count = get_options().get_frame_buffers();
+    if( count < MIN_FRAME_BUFFERS )
+        count = MIN_FRAME_BUFFERS;
+    else if( count > MAX_FRAME_BUFFERS )
+        count = MAX_FRAME_BUFFERS;
+
+    size_t size = 0;
+    size_t offsets[3] = { 0, 0, 0 };
+    for( unsigned i = 0; i < planes; ++i ) {
+        offsets[i] = size;
+        size += (size_t)pitches[i] * lines[i];
+    }
     //+1 for vlc 2.0.3/2.1 bug workaround.
     //They writes after buffer end boundary by some reason unknown to me...
-    m_frame_buf.resize( (*pitches) * ((*lines)+1) );
+    size += (*pitches);
+
+    // slots are never reallocated, a retired frame may still be painted
+    unsigned allocated = 0;
+    plugin_lock(&m_frames_lock);
+    m_lock_seq = 0;
+    m_displayed_lock_seq = 0;
+    for( size_t i = 0; i < m_frames.size(); ++i ) {
+        FrameBuffer &fb = m_frames[i];
+        if( fb.retired )
+            continue;
+        if( fb.alloc )
+            free_frame_buf(fb);
+        fb.state = FrameBuffer::Free;
+        fb.locks = 0;
+        fb.seq = 0;
+        fb.lock_seq = 0;
+        // scaled buffers are allocated on demand, at the output size
+        if( fb.scaled || allocated == count + SPARE_FRAME_BUFFERS )
+            continue;
+        fb.width = m_media_width;
+        fb.height = m_media_height;
+        fb.pitch = (*pitches);
+        fb.planar = m_planar;
+        for( unsigned p = 0; p < 3; ++p ) {
+            fb.plane_pitch[p] = p < planes ? pitches[p] : 0;
+            fb.plane_offset[p] = offsets[p];
+        }
+        if( alloc_frame_buf(fb, size) )
+            ++allocated;
+    }
+
+    // the first frames are shown right away at the window size
+    m_out_width = m_media_width;
+    m_out_height = m_media_height;
+    fit_output_size(&m_out_width, &m_out_height);
+    plugin_unlock(&m_frames_lock);
 
-    return 1;
+    if( allocated < MIN_FRAME_BUFFERS + SPARE_FRAME_BUFFERS ) {
+        video_cleanup_cb();
+        return 0;
+    }
+
+    // the spare buffers are not announced to libvlc
+    return allocated - SPARE_FRAME_BUFFERS;
 }
 
 void VlcWindowlessBase::video_cleanup_cb()
 {
-    m_frame_buf.resize(0);
+    plugin_lock(&m_frames_lock);
+    for( size_t i = 0; i < m_frames.size(); ++i ) {
+        FrameBuffer &fb = m_frames[i];
+        if( m_painting && fb.state == FrameBuffer::Presenting ) {
+            fb.retired = true; // end_frame_paint() will release it
+            continue;
+        }
+        if( fb.alloc )
+            free_frame_buf(fb);
+        fb.state = FrameBuffer::Free;
+    }
     m_media_width = 0;
     m_media_height = 0;
+    m_out_width = 0;
+    m_out_height = 0;
+    plugin_unlock(&m_frames_lock);
+}
+
+/* called with m_frames_lock held */
+VlcWindowlessBase::FrameBuffer *VlcWindowlessBase::grab_frame_buf(bool scaled)
+{
+    FrameBuffer *oldest_ready = 0, *oldest_decoded = 0;
+    for( size_t i = 0; i < m_frames.size(); ++i ) {
+        FrameBuffer &fb = m_frames[i];
+        // scaled buffers may not be allocated yet
+        if( fb.scaled != scaled || (!fb.data && !scaled) || fb.retired )
+            continue;
+        if( fb.state == FrameBuffer::Free )
+            return &fb;
+        // libvlc displays in lock order, this one was dropped
+        if( fb.state == FrameBuffer::Decoded &&
+            fb.lock_seq < m_displayed_lock_seq )
+            return &fb;
+        if( fb.state == FrameBuffer::Ready &&
+            ( !oldest_ready || fb.seq < oldest_ready->seq ) )
+            oldest_ready = &fb;
+        if( fb.state == FrameBuffer::Decoded &&
+            ( !oldest_decoded || fb.lock_seq < oldest_decoded->lock_seq ) )
+            oldest_decoded = &fb;
+    }
+    // decoder is ahead of the painter, drop the frame it has not shown yet
+    if( oldest_ready ) {
+        plugin_atomic_add(&m_frames_coalesced, 1);
+        return oldest_ready;
+    }
+    // libvlc holds fewer pictures than there are buffers: when none is
+    // left, one of the decoded ones was dropped without being displayed
+    return oldest_decoded;
+}
+
+/* called with m_frames_lock held */
+void VlcWindowlessBase::drop_frame_buf(FrameBuffer &fb)
+{
+    if( fb.retired ) {
+        free_frame_buf(fb);
+        fb.retired = false;
+    }
+    fb.state = FrameBuffer::Free;
 }
 
 void* VlcWindowlessBase::video_lock_cb(void **planes)
 {
-    (*planes) = m_frame_buf.empty()? 0 : &m_frame_buf[0];
-    return 0;
+    plugin_lock(&m_frames_lock);
+    FrameBuffer *fb = grab_frame_buf(false);
+    if( fb ) {
+        // a recycled picture gets a new lock/unlock pair
+        if( fb->state != FrameBuffer::Decoding )
+            fb->locks = 0;
+        fb->state = FrameBuffer::Decoding;
+        fb->locks++;
+        fb->lock_seq = ++m_lock_seq;
+    }
+    plugin_unlock(&m_frames_lock);
+
+    if( fb && fb->planar ) {
+        for( unsigned i = 0; i < 3; ++i )
+            planes[i] = fb->plane_pitch[i] ? fb->data + fb->plane_offset[i] : 0;
+    }
+    else
+        (*planes) = fb ? fb->data : 0;
+    return fb;
+}
+
+void VlcWindowlessBase::video_unlock_cb(void* picture, void *const * /*planes*/)
+{
+    FrameBuffer *fb = static_cast<FrameBuffer *>(picture);
+    if( !fb )
+        return;
+
+    plugin_lock(&m_frames_lock);
+    // decoded but not displayed yet: the buffer stays out of the free
+    // list until frame_displayed() or a later lock takes it
+    if( fb->locks && --fb->locks == 0 && fb->state == FrameBuffer::Decoding )
+        fb->state = FrameBuffer::Decoded;
+    plugin_unlock(&m_frames_lock);
+}
+
+const VlcWindowlessBase::FrameBuffer *VlcWindowlessBase::begin_frame_paint()
+{
+    plugin_lock(&m_frames_lock);
+    m_painting = true;
+    // the browser caught up, next displayed frame may invalidate again
+    plugin_atomic_swap(&m_invalidate_pending, 0);
+
+    FrameBuffer *ready = 0, *presenting = 0;
+    for( size_t i = 0; i < m_frames.size(); ++i ) {
+        FrameBuffer &fb = m_frames[i];
+        if( fb.state == FrameBuffer::Ready )
+            ready = &fb;
+        else if( fb.state == FrameBuffer::Presenting )
+            presenting = &fb;
+    }
+    if( ready ) {
+        if( presenting )
+            drop_frame_buf(*presenting);
+        ready->state = FrameBuffer::Presenting;
+        presenting = ready;
+    }
+    plugin_unlock(&m_frames_lock);
+
+    return presenting;
 }
 
-void VlcWindowlessBase::video_unlock_cb(void* /*picture*/, void *const * /*planes*/)
+void VlcWindowlessBase::end_frame_paint()
 {
+    plugin_lock(&m_frames_lock);
+    m_painting = false;
+    for( size_t i = 0; i < m_frames.size(); ++i )
+        if( m_frames[i].retired )
+            drop_frame_buf(m_frames[i]);
+    plugin_unlock(&m_frames_lock);
 }
 
 void VlcWindowlessBase::invalidate_window()
@@ -89,16 +443,211 @@ void VlcWindowlessBase::invalidate_window()
     rect.top = 0;
     rect.right = npwindow.width;
     rect.bottom = npwindow.height;
+
+    // the letterbox bars only change with the video size, a new frame of
+    // the same size only damages the video area
+    unsigned width = m_out_width, height = m_out_height;
+    if( upscales_on_present() ) {
+        unsigned fit_width = width, fit_height = height;
+        fit_size(&fit_width, &fit_height, npwindow.width, npwindow.height);
+        // as painted: XRender fits frames both ways, the others only
+        // enlarge them
+        if( scales_on_present() || fit_width > width ) {
+            width = fit_width;
+            height = fit_height;
+        }
+    }
+    if( width && width == m_invalidated_width &&
+        height && height == m_invalidated_height &&
+        width <= npwindow.width && height <= npwindow.height )
+    {
+        rect.left = (npwindow.width - width) / 2;
+        rect.top = (npwindow.height - height) / 2;
+        rect.right = rect.left + width;
+        rect.bottom = rect.top + height;
+    }
+    m_invalidated_width = width;
+    m_invalidated_height = height;
+
+    // no NPN_ForceRedraw(): let the browser paint at its own pace
     NPN_InvalidateRect(p_browser, &rect);
-    NPN_ForceRedraw(p_browser);
 }
 
-void VlcWindowlessBase::video_display_cb(void * /*picture*/)
+void VlcWindowlessBase::schedule_invalidate()
+{
+    // at most one invalidation in flight, cleared by begin_frame_paint()
+    if( !plugin_atomic_cas(&m_invalidate_pending, 0, 1) ) {
+        plugin_atomic_add(&m_invalidates_coalesced, 1);
+        return;
+    }
+
+    NPN_PluginThreadAsyncCall(p_browser,
+                              VlcWindowlessBase::invalidate_window_proxy,
+                              this);
+}
+
+struct convert_job_t
+{
+    const yuv_convert_t *conv;
+    yuv_frame_t src;
+    uint8_t *dst;
+    unsigned dst_pitch;
+};
+
+static void convert_stripe(void *opaque, unsigned first_line, unsigned last_line)
+{
+    convert_job_t *job = static_cast<convert_job_t *>(opaque);
+    yuv_to_rgb32(*job->conv, job->src, job->dst, job->dst_pitch,
+                 first_line, last_line);
+}
+
+struct scale_job_t
 {
+    const uint8_t *src;
+    unsigned src_pitch, src_width, src_height;
+    uint8_t *dst;
+    unsigned dst_pitch, dst_width, dst_height;
+};
+
+static void scale_stripe(void *opaque, unsigned first_line, unsigned last_line)
+{
+    scale_job_t *job = static_cast<scale_job_t *>(opaque);
+    scale_rgb32(job->src, job->src_pitch, job->src_width, job->src_height,
+                job->dst, job->dst_pitch, job->dst_width, job->dst_height,
+                first_line, last_line);
+}
+
+/* called from the libvlc video thread */
+VlcWindowlessBase::FrameBuffer *
+VlcWindowlessBase::render_frame(const FrameBuffer &src)
+{
+    plugin_lock(&m_frames_lock);
+    unsigned width = m_out_width, height = m_out_height;
+    FrameBuffer *fb = grab_frame_buf(true);
+    if( fb )
+        fb->state = FrameBuffer::Decoding;
+    plugin_unlock(&m_frames_lock);
+
+    if( !fb )
+        return 0;
+
+    // Decoding state keeps the painter away from fb while it is (re)filled
+    unsigned pitch = width * DEF_PIXEL_BYTES;
+    if( !fb->data || fb->width != width || fb->height != height ) {
+        if( fb->alloc )
+            free_frame_buf(*fb);
+        fb->width = width;
+        fb->height = height;
+        fb->pitch = pitch;
+        if( !alloc_frame_buf(*fb, pitch * height) ) {
+            plugin_lock(&m_frames_lock);
+            fb->state = FrameBuffer::Free;
+            plugin_unlock(&m_frames_lock);
+            return 0;
+        }
+    }
+
+    // stripes are joined before the frame is published as Ready
+    scale_job_t scale;
+    scale.dst = (uint8_t *)fb->data;
+    scale.dst_pitch = fb->pitch;
+    scale.dst_width = fb->width;
+    scale.dst_height = fb->height;
+
+    if( !src.planar ) {
+        scale.src = (const uint8_t *)src.data;
+        scale.src_pitch = src.pitch;
+        scale.src_width = src.width;
+        scale.src_height = src.height;
+        m_workers.run(scale_stripe, &scale, width, height);
+        return fb;
+    }
+
+    convert_job_t convert;
+    convert.conv = &m_convert;
+    for( unsigned i = 0; i < 3; ++i ) {
+        convert.src.plane[i] = (const uint8_t *)src.data + src.plane_offset[i];
+        convert.src.pitch[i] = src.plane_pitch[i];
+    }
+    convert.src.width = src.width;
+    convert.src.height = src.height;
+
+    // at the native size the conversion writes straight into the output
+    if( src.width == width && src.height == height ) {
+        convert.dst = (uint8_t *)fb->data;
+        convert.dst_pitch = fb->pitch;
+        m_workers.run(convert_stripe, &convert, width, height);
+        return fb;
+    }
+
+    // scaling reads across stripe boundaries: convert the whole frame first
+    convert.dst_pitch = src.width * DEF_PIXEL_BYTES;
+    m_convert_buf.resize((size_t)convert.dst_pitch * src.height);
+    convert.dst = (uint8_t *)&m_convert_buf[0];
+    m_workers.run(convert_stripe, &convert, src.width, src.height);
+
+    scale.src = convert.dst;
+    scale.src_pitch = convert.dst_pitch;
+    scale.src_width = src.width;
+    scale.src_height = src.height;
+    m_workers.run(scale_stripe, &scale, width, height);
+    return fb;
+}
+
+void VlcWindowlessBase::frame_displayed(void *picture)
+{
+    FrameBuffer *fb = static_cast<FrameBuffer *>(picture);
+    if( !fb )
+        return;
+
+    plugin_lock(&m_frames_lock);
+    // a buffer recycled since it was decoded holds another picture now
+    if( fb->state != FrameBuffer::Decoded ) {
+        plugin_unlock(&m_frames_lock);
+        return;
+    }
+    if( fb->lock_seq > m_displayed_lock_seq )
+        m_displayed_lock_seq = fb->lock_seq;
+    update_output_size();
+    // planar frames always go through render_frame()
+    bool passthrough = !fb->planar &&
+                       m_out_width == fb->width && m_out_height == fb->height;
+    // keeps the source away from video_lock_cb() while it is read
+    if( !passthrough )
+        fb->state = FrameBuffer::Decoding;
+    plugin_unlock(&m_frames_lock);
+
+    if( !passthrough ) {
+        FrameBuffer *src = fb;
+        fb = render_frame(*src);
+
+        plugin_lock(&m_frames_lock);
+        src->state = FrameBuffer::Free;
+        plugin_unlock(&m_frames_lock);
+        if( !fb )
+            return;
+    }
+
+    plugin_lock(&m_frames_lock);
+    // only the newest frame is worth painting
+    for( size_t i = 0; i < m_frames.size(); ++i )
+        if( m_frames[i].state == FrameBuffer::Ready ) {
+            m_frames[i].state = FrameBuffer::Free;
+            plugin_atomic_add(&m_frames_coalesced, 1);
+        }
+    fb->state = FrameBuffer::Ready;
+    fb->seq = ++m_frame_seq;
+    plugin_unlock(&m_frames_lock);
+
+    plugin_atomic_add(&m_frames_displayed, 1);
+}
+
+void VlcWindowlessBase::video_display_cb(void *picture)
+{
+    frame_displayed(picture);
+
     if (p_browser) {
-        NPN_PluginThreadAsyncCall(p_browser,
-                                  VlcWindowlessBase::invalidate_window_proxy,
-                                  this);
+        schedule_invalidate();
     }
 }
 
@@ -112,4 +661,3 @@ void VlcWindowlessBase::set_player_window() {
                                video_display_proxy,
                                this);
 }
-
@@ -30,6 +30,8 @@
 #define __VLCWINDOWLESS_BASE_H__
 
 #include "vlcplugin_base.h"
+#include "vlcwindowless_convert.h"
+#include "vlcwindowless_workers.h"
 
 #ifdef XP_MACOSX
 const char DEF_CHROMA[] = "RGBA";
@@ -37,13 +39,30 @@ const char DEF_CHROMA[] = "RGBA";
 const char DEF_CHROMA[] = "RV32";
 #endif
 enum{
-    DEF_PIXEL_BYTES = 4
+    DEF_PIXEL_BYTES = 4,
+    MIN_FRAME_BUFFERS = 2,
+    MAX_FRAME_BUFFERS = 8,
+    // allocated on top of the ones given to libvlc: one frame may be
+    // painted while libvlc holds all of its pictures
+    SPARE_FRAME_BUFFERS = 1,
+    FRAME_BUF_ALIGN = 32,
+    // extra buffers holding frames converted to RGB or scaled to the
+    // window size
+    SCALED_FRAME_BUFFERS = 3,
+    // largest frame requested from libvlc, scaled down on our side
+    MAX_DECODE_WIDTH = 1920,
+    MAX_DECODE_HEIGHT = 1080,
+    // window size changes smaller than this are ignored
+    RESIZE_HYSTERESIS = 8,
+    // window size must be stable that long (ms) before rescaling
+    RESIZE_DEBOUNCE = 150
 };
 
 class VlcWindowlessBase : public VlcPluginBase
 {
 public:
     VlcWindowlessBase(NPP, NPuint16_t);
+    virtual ~VlcWindowlessBase();
 
     //for libvlc_video_set_format_callbacks
     static unsigned video_format_proxy(void **opaque, char *chroma,
@@ -78,8 +97,17 @@ public:
         { reinterpret_cast<VlcWindowlessBase*>(opaque)->invalidate_window(); }
     void invalidate_window();
 
+    unsigned get_frames_displayed()
+        { return plugin_atomic_get(&m_frames_displayed); }
+    unsigned get_frames_coalesced()
+        { return plugin_atomic_get(&m_frames_coalesced); }
+    unsigned get_invalidates_coalesced()
+        { return plugin_atomic_get(&m_invalidates_coalesced); }
+
     void set_player_window();
 
+    void setWindow(const NPWindow &window);
+
 
     bool create_windows() { return true; }
     bool resize_windows() { return true; }
@@ -95,8 +123,107 @@ public:
     void popup_menu()           {/* STUB */}
 
 protected:
-    std::vector<char> m_frame_buf;
+    /*
+     * Frames travel free -> decoding (locked by libvlc) -> decoded
+     * (unlocked, waiting for display) -> ready (displayed by libvlc) ->
+     * presenting (painted by the browser thread) -> free.
+     * Only the newest ready frame is kept, older ones are recycled, so the
+     * painter never reads a buffer libvlc is writing to. A decoded frame
+     * libvlc never displays is recycled by a later lock.
+     */
+    struct FrameBuffer
+    {
+        enum State { Free, Decoding, Decoded, Ready, Presenting };
+
+        State     state;
+        unsigned  locks;    /* pending libvlc lock/unlock pairs */
+        unsigned  seq;      /* display order */
+        unsigned  lock_seq; /* lock order */
+        bool      retired;  /* released while being painted */
+        bool      scaled;   /* holds a frame scaled to the window size */
+        bool      planar;   /* holds a YUV frame, never painted as is */
+        char     *data;     /* FRAME_BUF_ALIGN aligned pixels */
+        void     *alloc;    /* backing allocation */
+        size_t    size;
+        unsigned  width;
+        unsigned  height;
+        unsigned  pitch;
+        unsigned  plane_pitch[3];
+        size_t    plane_offset[3];
+        int       shmid;    /* shared memory backing data, -1 when private */
+        uint32_t  shmseg;   /* its segment on the server, 0 until attached */
+    };
+
+    // painter side: returns the newest displayed frame, or NULL when there
+    // is nothing to draw. Always pair with end_frame_paint().
+    const FrameBuffer *begin_frame_paint();
+    void end_frame_paint();
+    // decoder side: publishes the picture returned by video_lock_cb()
+    void frame_displayed(void *picture);
+    // posts an invalidation unless one is still waiting to be painted
+    void schedule_invalidate();
+
+    // true if the painter scales frames itself, off the browser main
+    // thread (XRender on the X server): they are then kept at their
+    // decoded size, and only converted from YUV
+    virtual bool scales_on_present() { return false; }
+    // true if the painter may enlarge frames when painting them (GDI,
+    // Quartz). Frames larger than the window are still scaled down on
+    // the video thread, the browser main thread never shrinks them.
+    virtual bool upscales_on_present() { return scales_on_present(); }
+    // fit a width x height picture in the given box, keeping its aspect
+    static void fit_size(unsigned *width, unsigned *height,
+                         unsigned box_width, unsigned box_height);
+
+    virtual bool alloc_frame_buf(FrameBuffer &fb, size_t size);
+    virtual void free_frame_buf(FrameBuffer &fb);
+    // must be called by subclasses overriding free_frame_buf() from
+    // their destructor
+    void release_frame_pool();
+
     unsigned int m_media_width;
     unsigned int m_media_height;
+
+private:
+    FrameBuffer *grab_frame_buf(bool scaled);
+    void drop_frame_buf(FrameBuffer &fb);
+    void update_output_size();
+    void fit_output_size(unsigned *width, unsigned *height);
+    FrameBuffer *render_frame(const FrameBuffer &src);
+    unsigned planar_format(char *chroma, unsigned *pitches, unsigned *lines);
+
+    std::vector<FrameBuffer> m_frames;
+    plugin_lock_t m_frames_lock;
+    unsigned m_frame_seq;
+    unsigned m_lock_seq;
+    // lock order of the last displayed picture, decoded pictures locked
+    // before it were dropped by libvlc
+    unsigned m_displayed_lock_seq;
+    bool m_painting;
+
+    // planar (YUV) decoding, converted in render_frame()
+    bool m_planar;
+    yuv_convert_t m_convert;
+    // converted frame waiting to be scaled, video thread only
+    std::vector<char> m_convert_buf;
+    // splits render_frame() work between threads
+    WorkerPool m_workers;
+
+    plugin_atomic_t m_invalidate_pending;
+    plugin_atomic_t m_frames_displayed;
+    plugin_atomic_t m_frames_coalesced;    /* displayed but never painted */
+    plugin_atomic_t m_invalidates_coalesced;
+
+    // size of the painted frames, follows the window size
+    unsigned m_out_width;
+    unsigned m_out_height;
+    // window size requested by the last setWindow()
+    unsigned m_req_width;
+    unsigned m_req_height;
+    int64_t m_req_time;
+
+    // video size covered by the last invalidation
+    unsigned m_invalidated_width;
+    unsigned m_invalidated_height;
 };
 #endif
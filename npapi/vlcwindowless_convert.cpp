@@ -0,0 +1,468 @@
+/*****************************************************************************
+ * vlcwindowless_convert.cpp: YUV to RGB conversion for the window-less plugin
+ *****************************************************************************
+ * Copyright (C) 2013 VLC Authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "vlcwindowless_convert.h"
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+/* kernels are built for their own target and selected at runtime */
+# define CONVERT_SSE2 1
+# define CONVERT_AVX2 1
+# define TARGET_SSE2 __attribute__((target("sse2")))
+# define TARGET_AVX2 __attribute__((target("avx2")))
+# include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+# define CONVERT_SSE2 1
+# define TARGET_SSE2
+# include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+# define CONVERT_NEON 1
+# include <arm_neon.h>
+#endif
+
+void yuv_convert_init(yuv_convert_t *conv, yuv_matrix_e matrix,
+                      bool full_range, yuv_layout_e layout, rgb_order_e order)
+{
+    /* Kr/Kb derived factors */
+    double cr_r, cb_g, cr_g, cb_b;
+    if( matrix == yuv_matrix_bt709 ) {
+        cr_r = 1.5748;
+        cb_g = 0.187324;
+        cr_g = 0.468124;
+        cb_b = 1.8556;
+    } else {
+        cr_r = 1.402;
+        cb_g = 0.344136;
+        cr_g = 0.714136;
+        cb_b = 1.772;
+    }
+
+    /* limited range: Y in [16, 235], Cb/Cr in [16, 240] */
+    double y_scale = full_range ? 1. : 255. / 219.;
+    double c_scale = full_range ? 1. : 255. / 224.;
+
+    conv->y_offset = full_range ? 0 : 16;
+    conv->y_mul = (int16_t)floor(64. * y_scale + .5);
+    conv->cr_r  = (int16_t)floor(64. * c_scale * cr_r + .5);
+    conv->cb_g  = (int16_t)-floor(64. * c_scale * cb_g + .5);
+    conv->cr_g  = (int16_t)-floor(64. * c_scale * cr_g + .5);
+    conv->cb_b  = (int16_t)floor(64. * c_scale * cb_b + .5);
+    conv->layout = layout;
+    conv->order = order;
+}
+
+/*
+ * Plain C
+ */
+static inline int sat16(int v)
+{
+    return v < -32768 ? -32768 : v > 32767 ? 32767 : v;
+}
+
+static inline uint8_t clip8(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+typedef void (*convert_row_t)(const yuv_convert_t &c, const uint8_t *y,
+                              const uint8_t *u, const uint8_t *v,
+                              uint8_t *dst, unsigned width);
+
+/* for NV12, u points to the UV plane and v is unused */
+static void convert_row_c(const yuv_convert_t &c, const uint8_t *y,
+                          const uint8_t *u, const uint8_t *v,
+                          uint8_t *dst, unsigned width)
+{
+    const int first = c.order == rgb_order_bgra ? 2 : 0;
+    for( unsigned x = 0; x < width; ++x )
+    {
+        int cb, cr;
+        if( c.layout == yuv_layout_nv12 ) {
+            cb = u[(x & ~1u)] - 128;
+            cr = u[(x & ~1u) + 1] - 128;
+        } else {
+            cb = u[x / 2] - 128;
+            cr = v[x / 2] - 128;
+        }
+
+        int yy = sat16((y[x] - c.y_offset) * c.y_mul + 32);
+        uint8_t *px = dst + 4 * x;
+        px[first]     = clip8(sat16(yy + cr * c.cr_r) >> 6);
+        px[1]         = clip8(sat16(sat16(yy + cb * c.cb_g) + cr * c.cr_g) >> 6);
+        px[2 - first] = clip8(sat16(yy + cb * c.cb_b) >> 6);
+        px[3]         = 0xff;
+    }
+}
+
+/*
+ * SSE2: 16 pixels per iteration
+ */
+#ifdef CONVERT_SSE2
+TARGET_SSE2
+static inline void convert_8_sse2(const yuv_convert_t &c, __m128i y,
+                                  __m128i cb, __m128i cr,
+                                  __m128i *r, __m128i *g, __m128i *b)
+{
+    __m128i yy = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(c.y_offset)),
+                                 _mm_set1_epi16(c.y_mul));
+    yy = _mm_adds_epi16(yy, _mm_set1_epi16(32));
+
+    *r = _mm_adds_epi16(yy, _mm_mullo_epi16(cr, _mm_set1_epi16(c.cr_r)));
+    *g = _mm_adds_epi16(yy, _mm_mullo_epi16(cb, _mm_set1_epi16(c.cb_g)));
+    *g = _mm_adds_epi16(*g, _mm_mullo_epi16(cr, _mm_set1_epi16(c.cr_g)));
+    *b = _mm_adds_epi16(yy, _mm_mullo_epi16(cb, _mm_set1_epi16(c.cb_b)));
+    *r = _mm_srai_epi16(*r, 6);
+    *g = _mm_srai_epi16(*g, 6);
+    *b = _mm_srai_epi16(*b, 6);
+}
+
+TARGET_SSE2
+static void convert_row_sse2(const yuv_convert_t &c, const uint8_t *y,
+                             const uint8_t *u, const uint8_t *v,
+                             uint8_t *dst, unsigned width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi8((char)0xff);
+    const __m128i bias = _mm_set1_epi16(128);
+
+    unsigned x = 0;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        __m128i y8 = _mm_loadu_si128((const __m128i *)(y + x));
+        __m128i cb, cr;
+        if( c.layout == yuv_layout_nv12 ) {
+            __m128i uv = _mm_loadu_si128((const __m128i *)(u + x));
+            cb = _mm_and_si128(uv, _mm_set1_epi16(0xff));
+            cr = _mm_srli_epi16(uv, 8);
+        } else {
+            cb = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(u + x / 2)), zero);
+            cr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(v + x / 2)), zero);
+        }
+        cb = _mm_sub_epi16(cb, bias);
+        cr = _mm_sub_epi16(cr, bias);
+
+        __m128i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+        convert_8_sse2(c, _mm_unpacklo_epi8(y8, zero),
+                       _mm_unpacklo_epi16(cb, cb), _mm_unpacklo_epi16(cr, cr),
+                       &r_lo, &g_lo, &b_lo);
+        convert_8_sse2(c, _mm_unpackhi_epi8(y8, zero),
+                       _mm_unpackhi_epi16(cb, cb), _mm_unpackhi_epi16(cr, cr),
+                       &r_hi, &g_hi, &b_hi);
+
+        __m128i r = _mm_packus_epi16(r_lo, r_hi);
+        __m128i g = _mm_packus_epi16(g_lo, g_hi);
+        __m128i b = _mm_packus_epi16(b_lo, b_hi);
+        if( c.order == rgb_order_bgra ) {
+            __m128i t = r; r = b; b = t;
+        }
+
+        /* r/b are the first/third bytes of each pixel from here */
+        __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+        __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+        __m128i ba_lo = _mm_unpacklo_epi8(b, alpha);
+        __m128i ba_hi = _mm_unpackhi_epi8(b, alpha);
+
+        __m128i *out = (__m128i *)(dst + 4 * x);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+    }
+
+    if( x < width )
+        convert_row_c(c, y + x,
+                      c.layout == yuv_layout_nv12 ? u + x : u + x / 2,
+                      c.layout == yuv_layout_nv12 ? v : v + x / 2,
+                      dst + 4 * x, width - x);
+}
+#endif
+
+/*
+ * AVX2: 32 pixels per iteration
+ */
+#ifdef CONVERT_AVX2
+TARGET_AVX2
+static inline void convert_16_avx2(const yuv_convert_t &c, __m256i y,
+                                   __m256i cb, __m256i cr,
+                                   __m256i *r, __m256i *g, __m256i *b)
+{
+    __m256i yy = _mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(c.y_offset)),
+                                    _mm256_set1_epi16(c.y_mul));
+    yy = _mm256_adds_epi16(yy, _mm256_set1_epi16(32));
+
+    *r = _mm256_adds_epi16(yy, _mm256_mullo_epi16(cr, _mm256_set1_epi16(c.cr_r)));
+    *g = _mm256_adds_epi16(yy, _mm256_mullo_epi16(cb, _mm256_set1_epi16(c.cb_g)));
+    *g = _mm256_adds_epi16(*g, _mm256_mullo_epi16(cr, _mm256_set1_epi16(c.cr_g)));
+    *b = _mm256_adds_epi16(yy, _mm256_mullo_epi16(cb, _mm256_set1_epi16(c.cb_b)));
+    *r = _mm256_srai_epi16(*r, 6);
+    *g = _mm256_srai_epi16(*g, 6);
+    *b = _mm256_srai_epi16(*b, 6);
+}
+
+TARGET_AVX2
+static void convert_row_avx2(const yuv_convert_t &c, const uint8_t *y,
+                             const uint8_t *u, const uint8_t *v,
+                             uint8_t *dst, unsigned width)
+{
+    const __m256i alpha = _mm256_set1_epi8((char)0xff);
+    const __m256i bias = _mm256_set1_epi16(128);
+
+    unsigned x = 0;
+    for( ; x + 32 <= width; x += 32 )
+    {
+        __m256i y8 = _mm256_loadu_si256((const __m256i *)(y + x));
+        __m256i cb, cr;
+        if( c.layout == yuv_layout_nv12 ) {
+            __m256i uv = _mm256_loadu_si256((const __m256i *)(u + x));
+            cb = _mm256_and_si256(uv, _mm256_set1_epi16(0xff));
+            cr = _mm256_srli_epi16(uv, 8);
+        } else {
+            cb = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(u + x / 2)));
+            cr = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(v + x / 2)));
+        }
+        /* reorder the quadwords so that the in-lane unpacks below
+         * duplicate chroma samples 0-7 and 8-15 in pixel order */
+        cb = _mm256_permute4x64_epi64(_mm256_sub_epi16(cb, bias), 0xD8);
+        cr = _mm256_permute4x64_epi64(_mm256_sub_epi16(cr, bias), 0xD8);
+
+        __m256i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+        convert_16_avx2(c, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(y8)),
+                        _mm256_unpacklo_epi16(cb, cb), _mm256_unpacklo_epi16(cr, cr),
+                        &r_lo, &g_lo, &b_lo);
+        convert_16_avx2(c, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(y8, 1)),
+                        _mm256_unpackhi_epi16(cb, cb), _mm256_unpackhi_epi16(cr, cr),
+                        &r_hi, &g_hi, &b_hi);
+
+        /* packus works per lane, put the pixels back in order */
+        __m256i r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r_lo, r_hi), 0xD8);
+        __m256i g = _mm256_permute4x64_epi64(_mm256_packus_epi16(g_lo, g_hi), 0xD8);
+        __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b_lo, b_hi), 0xD8);
+        if( c.order == rgb_order_bgra ) {
+            __m256i t = r; r = b; b = t;
+        }
+
+        /* pixels 0-3/16-19, 4-7/20-23, 8-11/24-27, 12-15/28-31 */
+        __m256i rg_lo = _mm256_unpacklo_epi8(r, g);
+        __m256i rg_hi = _mm256_unpackhi_epi8(r, g);
+        __m256i ba_lo = _mm256_unpacklo_epi8(b, alpha);
+        __m256i ba_hi = _mm256_unpackhi_epi8(b, alpha);
+        __m256i p0 = _mm256_unpacklo_epi16(rg_lo, ba_lo);
+        __m256i p1 = _mm256_unpackhi_epi16(rg_lo, ba_lo);
+        __m256i p2 = _mm256_unpacklo_epi16(rg_hi, ba_hi);
+        __m256i p3 = _mm256_unpackhi_epi16(rg_hi, ba_hi);
+
+        __m256i *out = (__m256i *)(dst + 4 * x);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+
+    if( x < width )
+        convert_row_c(c, y + x,
+                      c.layout == yuv_layout_nv12 ? u + x : u + x / 2,
+                      c.layout == yuv_layout_nv12 ? v : v + x / 2,
+                      dst + 4 * x, width - x);
+}
+#endif
+
+/*
+ * NEON: 16 pixels per iteration
+ */
+#ifdef CONVERT_NEON
+static inline void convert_8_neon(const yuv_convert_t &c, int16x8_t y,
+                                  int16x8_t cb, int16x8_t cr,
+                                  uint8x8_t *r, uint8x8_t *g, uint8x8_t *b)
+{
+    int16x8_t yy = vmulq_s16(vsubq_s16(y, vdupq_n_s16(c.y_offset)),
+                             vdupq_n_s16(c.y_mul));
+    yy = vqaddq_s16(yy, vdupq_n_s16(32));
+
+    int16x8_t rr = vqaddq_s16(yy, vmulq_s16(cr, vdupq_n_s16(c.cr_r)));
+    int16x8_t gg = vqaddq_s16(yy, vmulq_s16(cb, vdupq_n_s16(c.cb_g)));
+    gg = vqaddq_s16(gg, vmulq_s16(cr, vdupq_n_s16(c.cr_g)));
+    int16x8_t bb = vqaddq_s16(yy, vmulq_s16(cb, vdupq_n_s16(c.cb_b)));
+    *r = vqmovun_s16(vshrq_n_s16(rr, 6));
+    *g = vqmovun_s16(vshrq_n_s16(gg, 6));
+    *b = vqmovun_s16(vshrq_n_s16(bb, 6));
+}
+
+static void convert_row_neon(const yuv_convert_t &c, const uint8_t *y,
+                             const uint8_t *u, const uint8_t *v,
+                             uint8_t *dst, unsigned width)
+{
+    const int16x8_t bias = vdupq_n_s16(128);
+
+    unsigned x = 0;
+    for( ; x + 16 <= width; x += 16 )
+    {
+        uint8x16_t y8 = vld1q_u8(y + x);
+        int16x8_t cb, cr;
+        if( c.layout == yuv_layout_nv12 ) {
+            uint8x8x2_t uv = vld2_u8(u + x);
+            cb = vreinterpretq_s16_u16(vmovl_u8(uv.val[0]));
+            cr = vreinterpretq_s16_u16(vmovl_u8(uv.val[1]));
+        } else {
+            cb = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x / 2)));
+            cr = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x / 2)));
+        }
+        int16x8x2_t cbz = vzipq_s16(vsubq_s16(cb, bias), vsubq_s16(cb, bias));
+        int16x8x2_t crz = vzipq_s16(vsubq_s16(cr, bias), vsubq_s16(cr, bias));
+
+        uint8x8_t r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+        convert_8_neon(c, vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y8))),
+                       cbz.val[0], crz.val[0], &r_lo, &g_lo, &b_lo);
+        convert_8_neon(c, vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y8))),
+                       cbz.val[1], crz.val[1], &r_hi, &g_hi, &b_hi);
+
+        uint8x16x4_t px;
+        px.val[0] = vcombine_u8(r_lo, r_hi);
+        px.val[1] = vcombine_u8(g_lo, g_hi);
+        px.val[2] = vcombine_u8(b_lo, b_hi);
+        px.val[3] = vdupq_n_u8(0xff);
+        if( c.order == rgb_order_bgra ) {
+            uint8x16_t t = px.val[0]; px.val[0] = px.val[2]; px.val[2] = t;
+        }
+        vst4q_u8(dst + 4 * x, px);
+    }
+
+    if( x < width )
+        convert_row_c(c, y + x,
+                      c.layout == yuv_layout_nv12 ? u + x : u + x / 2,
+                      c.layout == yuv_layout_nv12 ? v : v + x / 2,
+                      dst + 4 * x, width - x);
+}
+#endif
+
+/*
+ * Dispatch
+ */
+struct kernel_t
+{
+    const char   *name;
+    convert_row_t row;
+};
+
+enum { MAX_KERNELS = 3 };
+
+/* the kernels this CPU runs, slowest first */
+static unsigned usable_kernels(kernel_t *kernels)
+{
+    unsigned n = 0;
+    kernels[n].name = "c";
+    kernels[n++].row = convert_row_c;
+#if defined(CONVERT_AVX2)
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("sse2") ) {
+        kernels[n].name = "sse2";
+        kernels[n++].row = convert_row_sse2;
+    }
+    if( __builtin_cpu_supports("avx2") ) {
+        kernels[n].name = "avx2";
+        kernels[n++].row = convert_row_avx2;
+    }
+#elif defined(CONVERT_SSE2)
+    kernels[n].name = "sse2";
+    kernels[n++].row = convert_row_sse2;
+#elif defined(CONVERT_NEON)
+    kernels[n].name = "neon";
+    kernels[n++].row = convert_row_neon;
+#endif
+    return n;
+}
+
+static const char *s_impl_name = 0;
+
+static convert_row_t select_row()
+{
+    kernel_t kernels[MAX_KERNELS];
+    unsigned n = usable_kernels(kernels);
+    s_impl_name = kernels[n - 1].name;
+    return kernels[n - 1].row;
+}
+
+static convert_row_t get_row()
+{
+    /* racing threads would pick the same function */
+    static convert_row_t row = 0;
+    if( !row )
+        row = select_row();
+    return row;
+}
+
+static void convert(convert_row_t row, const yuv_convert_t &conv,
+                    const yuv_frame_t &src, uint8_t *dst, unsigned dst_pitch,
+                    unsigned first_line, unsigned last_line)
+{
+    if( last_line > src.height )
+        last_line = src.height;
+
+    for( unsigned line = first_line; line < last_line; ++line )
+    {
+        const uint8_t *y = src.plane[0] + line * src.pitch[0];
+        const uint8_t *u = src.plane[1] + (line / 2) * src.pitch[1];
+        const uint8_t *v = conv.layout == yuv_layout_nv12 ? NULL
+                         : src.plane[2] + (line / 2) * src.pitch[2];
+        row(conv, y, u, v, dst + line * dst_pitch, src.width);
+    }
+}
+
+void yuv_to_rgb32(const yuv_convert_t &conv, const yuv_frame_t &src,
+                  uint8_t *dst, unsigned dst_pitch,
+                  unsigned first_line, unsigned last_line)
+{
+    convert(get_row(), conv, src, dst, dst_pitch, first_line, last_line);
+}
+
+void yuv_to_rgb32_c(const yuv_convert_t &conv, const yuv_frame_t &src,
+                    uint8_t *dst, unsigned dst_pitch,
+                    unsigned first_line, unsigned last_line)
+{
+    convert(convert_row_c, conv, src, dst, dst_pitch, first_line, last_line);
+}
+
+const char *yuv_to_rgb32_impl()
+{
+    get_row();
+    return s_impl_name;
+}
+
+const char *yuv_to_rgb32_kernel_name(unsigned kernel)
+{
+    kernel_t kernels[MAX_KERNELS];
+    if( kernel >= usable_kernels(kernels) )
+        return 0;
+    return kernels[kernel].name;
+}
+
+void yuv_to_rgb32_kernel(unsigned kernel,
+                         const yuv_convert_t &conv, const yuv_frame_t &src,
+                         uint8_t *dst, unsigned dst_pitch,
+                         unsigned first_line, unsigned last_line)
+{
+    kernel_t kernels[MAX_KERNELS];
+    if( kernel >= usable_kernels(kernels) )
+        return;
+    convert(kernels[kernel].row, conv, src, dst, dst_pitch,
+            first_line, last_line);
+}
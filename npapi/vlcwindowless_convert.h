@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * vlcwindowless_convert.h: YUV to RGB conversion for the window-less plugin
+ *****************************************************************************
+ * Copyright (C) 2013 VLC Authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef __VLCWINDOWLESS_CONVERT_H__
+#define __VLCWINDOWLESS_CONVERT_H__
+
+#include <stdint.h>
+
+enum yuv_matrix_e
+{
+    yuv_matrix_bt601,
+    yuv_matrix_bt709
+};
+
+enum yuv_layout_e
+{
+    yuv_layout_i420,    /* Y, U and V planes */
+    yuv_layout_nv12     /* Y plane, interleaved UV plane */
+};
+
+enum rgb_order_e
+{
+    rgb_order_bgra,     /* RV32 on little endian X11/Windows */
+    rgb_order_rgba      /* Mac */
+};
+
+/* 4:2:0 source picture */
+struct yuv_frame_t
+{
+    const uint8_t *plane[3];
+    unsigned       pitch[3];
+    unsigned       width;
+    unsigned       height;
+};
+
+/*
+ * Conversion parameters, in 6 bits fixed point. Every implementation
+ * (C, SSE2, AVX2, NEON) does the very same 16 bits saturated arithmetic
+ * so their output is bit exact with yuv_to_rgb32_c().
+ */
+struct yuv_convert_t
+{
+    int16_t y_offset;
+    int16_t y_mul;
+    int16_t cr_r;
+    int16_t cb_g;
+    int16_t cr_g;
+    int16_t cb_b;
+    yuv_layout_e layout;
+    rgb_order_e order;
+};
+
+void yuv_convert_init(yuv_convert_t *conv, yuv_matrix_e matrix,
+                      bool full_range, yuv_layout_e layout, rgb_order_e order);
+
+/*
+ * Converts the source lines [first_line, last_line) to 32 bits pixels
+ * (alpha is opaque), using the best implementation for this CPU.
+ */
+void yuv_to_rgb32(const yuv_convert_t &conv, const yuv_frame_t &src,
+                  uint8_t *dst, unsigned dst_pitch,
+                  unsigned first_line, unsigned last_line);
+
+/* plain C reference implementation */
+void yuv_to_rgb32_c(const yuv_convert_t &conv, const yuv_frame_t &src,
+                    uint8_t *dst, unsigned dst_pitch,
+                    unsigned first_line, unsigned last_line);
+
+/* name of the implementation used by yuv_to_rgb32() */
+const char *yuv_to_rgb32_impl();
+
+/*
+ * Every implementation this CPU runs, for convert_check: kernel 0 is the
+ * C one, the name is NULL past the last kernel.
+ */
+const char *yuv_to_rgb32_kernel_name(unsigned kernel);
+void yuv_to_rgb32_kernel(unsigned kernel,
+                         const yuv_convert_t &conv, const yuv_frame_t &src,
+                         uint8_t *dst, unsigned dst_pitch,
+                         unsigned first_line, unsigned last_line);
+
+#endif /* __VLCWINDOWLESS_CONVERT_H__ */
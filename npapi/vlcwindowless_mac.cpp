@@ -249,7 +249,9 @@ bool VlcWindowlessMac::handle_event(void *event)
 
         CGContextClearRect(cgContext, CGRectMake(0, 0, npwindow.width, npwindow.height) );
 
-        if (m_media_width == 0 || m_media_height == 0 || (!lastFrame && !VlcPluginBase::playlist_isplaying()) || !get_player().is_open()) {
+        const FrameBuffer *frame = begin_frame_paint();
+        if (!frame || (!lastFrame && !VlcPluginBase::playlist_isplaying()) || !get_player().is_open()) {
+            end_frame_paint();
             drawNoPlayback(cgContext);
             return true;
         }
@@ -268,53 +270,56 @@ bool VlcWindowlessMac::handle_event(void *event)
         const size_t kBitsPerComponent = sizeof(unsigned char) * 8;
         CGRect rect;
 
-        if (m_media_width != 0 && m_media_height != 0) {
-            cached_width = m_media_width;
-            cached_height = m_media_height;
-            left = (npwindow.width  - m_media_width) / 2.;
-            top = (npwindow.height - m_media_height) / 2.;
-
-            /* fetch frame */
-            CFDataRef dataRef = CFDataCreateWithBytesNoCopy(kCFAllocatorDefault,
-                                                            (const uint8_t *)&m_frame_buf[0],
-                                                            sizeof(m_frame_buf[0]),
-                                                            kCFAllocatorNull);
-            CGDataProviderRef dataProvider = CGDataProviderCreateWithCFData(dataRef);
-            lastFrame = CGImageCreate(m_media_width,
-                                      m_media_height,
-                                      kBitsPerComponent,
-                                      kBitsPerComponent * kComponentsPerPixel,
-                                      kComponentsPerPixel * m_media_width,
-                                      colorspace,
-                                      kCGBitmapByteOrder16Big,
-                                      dataProvider,
-                                      NULL,
-                                      true,
-                                      kCGRenderingIntentPerceptual);
-
-            CGDataProviderRelease(dataProvider);
-            CFRelease(dataRef);
-
-            if (!lastFrame) {
-                fprintf(stderr, "image creation failed\n");
-                CGImageRelease(lastFrame);
-                CGContextRestoreGState(cgContext);
-                return true;
-            }
-
-            rect = CGRectMake(left, top, m_media_width, m_media_height);
-        } else {
-            fprintf(stderr, "drawing old frame again\n");
-            left = (npwindow.width - cached_width) / 2.;
-            top = (npwindow.height - cached_height) / 2.;
-            rect = CGRectMake(left, top, cached_width, cached_width);
+        cached_width = frame->width;
+        cached_height = frame->height;
+        /* frames are never larger than the window, Quartz only enlarges
+         * them */
+        unsigned width = frame->width, height = frame->height;
+        fit_size(&width, &height, npwindow.width, npwindow.height);
+        if (width < frame->width) {
+            width = frame->width;
+            height = frame->height;
         }
-
-        if(lastFrame) {
-            CGContextDrawImage(cgContext, rect, lastFrame);
-            CGImageRelease(lastFrame);
+        left = (npwindow.width  - width) / 2.;
+        top = (npwindow.height - height) / 2.;
+
+        /* fetch frame */
+        CFDataRef dataRef = CFDataCreateWithBytesNoCopy(kCFAllocatorDefault,
+                                                        (const uint8_t *)frame->data,
+                                                        frame->pitch * frame->height,
+                                                        kCFAllocatorNull);
+        CGDataProviderRef dataProvider = CGDataProviderCreateWithCFData(dataRef);
+        lastFrame = CGImageCreate(frame->width,
+                                  frame->height,
+                                  kBitsPerComponent,
+                                  kBitsPerComponent * kComponentsPerPixel,
+                                  frame->pitch,
+                                  colorspace,
+                                  kCGBitmapByteOrder16Big,
+                                  dataProvider,
+                                  NULL,
+                                  true,
+                                  kCGRenderingIntentPerceptual);
+
+        CGDataProviderRelease(dataProvider);
+        CFRelease(dataRef);
+
+        if (!lastFrame) {
+            fprintf(stderr, "image creation failed\n");
+            end_frame_paint();
+            CGContextRestoreGState(cgContext);
+            return true;
         }
 
+        rect = CGRectMake(left, top, width, height);
+        CGContextSetInterpolationQuality(cgContext, kCGInterpolationDefault);
+
+        /* the image references the frame pixels, draw it before
+         * handing the buffer back to the pool */
+        CGContextDrawImage(cgContext, rect, lastFrame);
+        CGImageRelease(lastFrame);
+        end_frame_paint();
+
         CGContextRestoreGState(cgContext);
 
         return true;
@@ -323,13 +328,13 @@ bool VlcWindowlessMac::handle_event(void *event)
     return VlcPluginBase::handle_event(event);
 }
 
-void VlcWindowlessMac::video_display_cb(void * /*picture*/)
+void VlcWindowlessMac::video_display_cb(void *picture)
 {
+    frame_displayed(picture);
+
     if (p_browser) {
         if (!legacy_drawing_mode)
-            NPN_PluginThreadAsyncCall(p_browser,
-                                      VlcWindowlessBase::invalidate_window_proxy,
-                                      this);
+            schedule_invalidate();
         else
             invalidate_window();
     }
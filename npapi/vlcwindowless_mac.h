@@ -36,6 +36,7 @@ public:
     NPError get_root_layer(void *value);
     void video_display_cb(void *picture);
     void set_player_window();
+    bool upscales_on_present() { return true; }
 
     static void video_display_proxy(void *opaque, void *picture)
     { reinterpret_cast<VlcWindowlessMac*>(opaque)->video_display_cb(picture); }
@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * vlcwindowless_scale.cpp: frame scaling for the window-less VLC plugin
+ *****************************************************************************
+ * Copyright (C) 2013 VLC Authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "vlcwindowless_scale.h"
+
+#include <cstring>
+
+/* 16.16 fixed point source coordinate of the center of dst pixel i */
+static inline int32_t src_coord(unsigned i, unsigned src_size, unsigned dst_size)
+{
+    int64_t pos = ((int64_t)(2 * i + 1) * src_size << 16) / (2 * dst_size);
+    pos -= 1 << 15;
+    return pos < 0 ? 0 : (int32_t)pos;
+}
+
+void scale_rgb32(const uint8_t *src, unsigned src_pitch,
+                 unsigned src_width, unsigned src_height,
+                 uint8_t *dst, unsigned dst_pitch,
+                 unsigned dst_width, unsigned dst_height,
+                 unsigned first_line, unsigned last_line)
+{
+    if( !src_width || !src_height || !dst_width || !dst_height )
+        return;
+    if( last_line > dst_height )
+        last_line = dst_height;
+
+    for( unsigned y = first_line; y < last_line; ++y )
+    {
+        int32_t sy = src_coord(y, src_height, dst_height);
+        unsigned y0 = sy >> 16;
+        unsigned y1 = y0 + 1 < src_height ? y0 + 1 : y0;
+        unsigned fy = (sy >> 8) & 0xff;
+
+        const uint8_t *row0 = src + y0 * src_pitch;
+        const uint8_t *row1 = src + y1 * src_pitch;
+        uint8_t *out = dst + y * dst_pitch;
+
+        if( src_width == dst_width && !fy ) {
+            memcpy(out, row0, dst_width * 4);
+            continue;
+        }
+
+        for( unsigned x = 0; x < dst_width; ++x )
+        {
+            int32_t sx = src_coord(x, src_width, dst_width);
+            unsigned x0 = sx >> 16;
+            unsigned x1 = x0 + 1 < src_width ? x0 + 1 : x0;
+            unsigned fx = (sx >> 8) & 0xff;
+
+            const uint8_t *p00 = row0 + x0 * 4, *p01 = row0 + x1 * 4;
+            const uint8_t *p10 = row1 + x0 * 4, *p11 = row1 + x1 * 4;
+            for( unsigned c = 0; c < 4; ++c )
+            {
+                unsigned top    = p00[c] * (256 - fx) + p01[c] * fx;
+                unsigned bottom = p10[c] * (256 - fx) + p11[c] * fx;
+                out[x * 4 + c] = (top * (256 - fy) + bottom * fy + (1 << 15)) >> 16;
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/*****************************************************************************
+ * vlcwindowless_scale.h: frame scaling for the window-less VLC plugin
+ *****************************************************************************
+ * Copyright (C) 2013 VLC Authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef __VLCWINDOWLESS_SCALE_H__
+#define __VLCWINDOWLESS_SCALE_H__
+
+#include <stdint.h>
+
+/*
+ * Bilinear scaling of 32 bits per pixel frames (RV32/RGBA, the four
+ * components are interpolated independently).
+ * Only the destination lines [first_line, last_line) are written so the
+ * work can be split between threads.
+ */
+void scale_rgb32(const uint8_t *src, unsigned src_pitch,
+                 unsigned src_width, unsigned src_height,
+                 uint8_t *dst, unsigned dst_pitch,
+                 unsigned dst_width, unsigned dst_height,
+                 unsigned first_line, unsigned last_line);
+
+#endif /* __VLCWINDOWLESS_SCALE_H__ */
@@ -71,14 +71,14 @@ bool VlcWindowlessWin::handle_event(void *event)
             LocalFree( lpMsgBuf );
         }
 
-        if ( m_frame_buf.size() &&
-             m_frame_buf.size() >= m_media_width * m_media_height * DEF_PIXEL_BYTES)
+        const FrameBuffer *frame = begin_frame_paint();
+        if ( frame )
         {
             BITMAPINFO BmpInfo; ZeroMemory(&BmpInfo, sizeof(BmpInfo));
             BITMAPINFOHEADER& BmpH = BmpInfo.bmiHeader;
             BmpH.biSize = sizeof(BITMAPINFOHEADER);
-            BmpH.biWidth = m_media_width;
-            BmpH.biHeight = -((int)m_media_height);
+            BmpH.biWidth = frame->pitch / DEF_PIXEL_BYTES;
+            BmpH.biHeight = -((int)frame->height);
             BmpH.biPlanes = 1;
             BmpH.biBitCount = DEF_PIXEL_BYTES*8;
             BmpH.biCompression = BI_RGB;
@@ -90,14 +90,26 @@ bool VlcWindowlessWin::handle_event(void *event)
             //BmpH.biClrImportant = 0;
 
 
-            ret = SetDIBitsToDevice(hDC,
-                            npwindow.x + (npwindow.width - m_media_width)/2,
-                            npwindow.y + (npwindow.height - m_media_height)/2,
-                            m_media_width, m_media_height,
+            // frames are never larger than the window, GDI only
+            // enlarges them
+            unsigned width = frame->width, height = frame->height;
+            fit_size(&width, &height, npwindow.width, npwindow.height);
+            if (width > frame->width) {
+                SetStretchBltMode(hDC, HALFTONE);
+                SetBrushOrgEx(hDC, 0, 0, NULL); // required after HALFTONE
+            } else {
+                width = frame->width;
+                height = frame->height;
+            }
+
+            ret = StretchDIBits(hDC,
+                            npwindow.x + (npwindow.width - width)/2,
+                            npwindow.y + (npwindow.height - height)/2,
+                            width, height,
                             0, 0,
-                            0, m_media_height,
-                            &m_frame_buf[0],
-                            &BmpInfo, DIB_RGB_COLORS);
+                            frame->width, frame->height,
+                            frame->data,
+                            &BmpInfo, DIB_RGB_COLORS, SRCCOPY);
             if (!ret) {
                 LPVOID lpMsgBuf;
                 FormatMessage(
@@ -112,11 +124,12 @@ bool VlcWindowlessWin::handle_event(void *event)
                     NULL
                 );
 
-                fprintf(stderr, "Error in SetDIBitsToDevice: %s\n", lpMsgBuf);
+                fprintf(stderr, "Error in StretchDIBits: %s\n", lpMsgBuf);
                 LocalFree( lpMsgBuf );
             }
 
         }
+        end_frame_paint();
         RestoreDC(hDC, savedID);
         return true;
     }
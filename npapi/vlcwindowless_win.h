@@ -34,6 +34,9 @@ public:
 
     bool handle_event(void *event);
 
+protected:
+    bool upscales_on_present() { return true; }
+
 private:
     HBRUSH m_hBgBrush;
 };
@@ -0,0 +1,240 @@
+/*****************************************************************************
+ * vlcwindowless_workers.cpp: worker threads for the window-less plugin
+ *****************************************************************************
+ * Copyright (C) 2013 VLC Authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include "vlcwindowless_workers.h"
+
+#if defined(HAVE_PTHREAD)
+# include <unistd.h>
+#endif
+
+WorkerPool::WorkerPool() :
+    m_threads(1), m_quit(false), m_job(0), m_opaque(0), m_lines(0),
+    m_stripes(0), m_next_stripe(0), m_pending(0)
+{
+    plugin_lock_init(&m_lock);
+#if defined(HAVE_PTHREAD)
+    pthread_cond_init(&m_start_cond, NULL);
+    pthread_cond_init(&m_done_cond, NULL);
+#elif defined(XP_WIN)
+    m_start_sem = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+    m_done_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+#endif
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop_workers();
+#if defined(HAVE_PTHREAD)
+    pthread_cond_destroy(&m_start_cond);
+    pthread_cond_destroy(&m_done_cond);
+#elif defined(XP_WIN)
+    CloseHandle(m_start_sem);
+    CloseHandle(m_done_event);
+#endif
+    plugin_lock_destroy(&m_lock);
+}
+
+unsigned WorkerPool::cpu_count()
+{
+    long count = 1;
+#if defined(XP_WIN)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    count = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? count : 1;
+}
+
+void WorkerPool::set_threads(unsigned count)
+{
+    if( count == 0 )
+        count = cpu_count();
+    if( count > MAX_WORKER_THREADS )
+        count = MAX_WORKER_THREADS;
+    if( count == m_threads )
+        return;
+
+    stop_workers();
+    m_threads = count;
+}
+
+bool WorkerPool::start_workers()
+{
+    unsigned count = m_threads - 1;
+    if( m_handles.size() == count )
+        return true;
+
+    m_quit = false;
+    for( unsigned i = 0; i < count; ++i ) {
+#if defined(HAVE_PTHREAD)
+        pthread_t thread;
+        if( pthread_create(&thread, NULL, worker_proxy, this) != 0 )
+            break;
+        m_handles.push_back(thread);
+#elif defined(XP_WIN)
+        HANDLE thread = CreateThread(NULL, 0, worker_proxy, this, 0, NULL);
+        if( !thread )
+            break;
+        m_handles.push_back(thread);
+#endif
+    }
+
+    if( m_handles.size() != count ) {
+        // run on the calling thread only from now on
+        stop_workers();
+        m_threads = 1;
+        return false;
+    }
+    return true;
+}
+
+void WorkerPool::stop_workers()
+{
+    if( m_handles.empty() )
+        return;
+
+    plugin_lock(&m_lock);
+    m_quit = true;
+#if defined(HAVE_PTHREAD)
+    pthread_cond_broadcast(&m_start_cond);
+#elif defined(XP_WIN)
+    ReleaseSemaphore(m_start_sem, m_handles.size(), NULL);
+#endif
+    plugin_unlock(&m_lock);
+
+    for( size_t i = 0; i < m_handles.size(); ++i ) {
+#if defined(HAVE_PTHREAD)
+        pthread_join(m_handles[i], NULL);
+#elif defined(XP_WIN)
+        WaitForSingleObject(m_handles[i], INFINITE);
+        CloseHandle(m_handles[i]);
+#endif
+    }
+    m_handles.clear();
+}
+
+#if defined(HAVE_PTHREAD)
+void *WorkerPool::worker_proxy(void *opaque)
+{
+    static_cast<WorkerPool *>(opaque)->worker_loop();
+    return NULL;
+}
+#elif defined(XP_WIN)
+DWORD WINAPI WorkerPool::worker_proxy(LPVOID opaque)
+{
+    static_cast<WorkerPool *>(opaque)->worker_loop();
+    return 0;
+}
+#endif
+
+void WorkerPool::worker_loop()
+{
+    for( ;; ) {
+#if defined(HAVE_PTHREAD)
+        plugin_lock(&m_lock);
+        while( !m_quit && m_next_stripe >= m_stripes )
+            pthread_cond_wait(&m_start_cond, &m_lock.mutex);
+        bool quit = m_quit;
+        plugin_unlock(&m_lock);
+#elif defined(XP_WIN)
+        // a late worker may eat the token of another one, it then finds
+        // no stripe left and sleeps again: the caller works too anyway
+        WaitForSingleObject(m_start_sem, INFINITE);
+        plugin_lock(&m_lock);
+        bool quit = m_quit;
+        plugin_unlock(&m_lock);
+#else
+        bool quit = true;
+#endif
+        if( quit )
+            return;
+        work();
+    }
+}
+
+void WorkerPool::work()
+{
+    plugin_lock(&m_lock);
+    while( m_next_stripe < m_stripes ) {
+        unsigned stripe = m_next_stripe++;
+        unsigned first_line = m_lines * stripe / m_stripes;
+        unsigned last_line = m_lines * (stripe + 1) / m_stripes;
+        job_t job = m_job;
+        void *opaque = m_opaque;
+        plugin_unlock(&m_lock);
+
+        job(opaque, first_line, last_line);
+
+        plugin_lock(&m_lock);
+        if( --m_pending == 0 ) {
+#if defined(HAVE_PTHREAD)
+            pthread_cond_signal(&m_done_cond);
+#elif defined(XP_WIN)
+            SetEvent(m_done_event);
+#endif
+        }
+    }
+    plugin_unlock(&m_lock);
+}
+
+void WorkerPool::run(job_t job, void *opaque, unsigned width, unsigned lines)
+{
+    unsigned stripes = (size_t)width * lines / MIN_STRIPE_PIXELS;
+    if( stripes > m_threads )
+        stripes = m_threads;
+    if( stripes <= 1 || !start_workers() ) {
+        job(opaque, 0, lines);
+        return;
+    }
+
+    plugin_lock(&m_lock);
+    m_job = job;
+    m_opaque = opaque;
+    m_lines = lines;
+    m_stripes = stripes;
+    m_next_stripe = 0;
+    m_pending = stripes;
+#if defined(HAVE_PTHREAD)
+    pthread_cond_broadcast(&m_start_cond);
+#elif defined(XP_WIN)
+    ReleaseSemaphore(m_start_sem, stripes - 1, NULL);
+#endif
+    plugin_unlock(&m_lock);
+
+    work();
+
+    // join: the frame is complete once every stripe is
+    plugin_lock(&m_lock);
+#if defined(HAVE_PTHREAD)
+    while( m_pending )
+        pthread_cond_wait(&m_done_cond, &m_lock.mutex);
+#elif defined(XP_WIN)
+    // the event may still be set by a previous frame, check m_pending
+    while( m_pending ) {
+        plugin_unlock(&m_lock);
+        WaitForSingleObject(m_done_event, INFINITE);
+        plugin_lock(&m_lock);
+    }
+#endif
+    plugin_unlock(&m_lock);
+}
@@ -0,0 +1,92 @@
+/*****************************************************************************
+ * vlcwindowless_workers.h: worker threads for the window-less plugin
+ *****************************************************************************
+ * Copyright (C) 2013 VLC Authors and VideoLAN
+ * $Id$
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef __VLCWINDOWLESS_WORKERS_H__
+#define __VLCWINDOWLESS_WORKERS_H__
+
+#include "common.h"
+#include "locking.h"
+
+#include <vector>
+
+enum{
+    MAX_WORKER_THREADS = 16,
+    // frames smaller than this (in pixels) per thread are not split
+    MIN_STRIPE_PIXELS = 256 * 1024
+};
+
+/*
+ * Persistent threads splitting per frame work into horizontal stripes.
+ * run() is called from a single thread (the libvlc video thread), which
+ * takes its share of the stripes and returns once all of them are done.
+ */
+class WorkerPool
+{
+public:
+    // lines [first_line, last_line) of a job
+    typedef void (*job_t)(void *opaque, unsigned first_line, unsigned last_line);
+
+    WorkerPool();
+    ~WorkerPool();
+
+    // total number of threads working on a frame, including the caller.
+    // 0 means one per CPU. Threads are started by the next run().
+    void set_threads(unsigned count);
+    unsigned get_threads() const { return m_threads; }
+
+    void run(job_t job, void *opaque, unsigned width, unsigned lines);
+
+    static unsigned cpu_count();
+
+private:
+    bool start_workers();
+    void stop_workers();
+    // takes and runs the stripes of the current job, returns once there
+    // are none left
+    void work();
+    void worker_loop();
+
+#if defined(HAVE_PTHREAD)
+    static void *worker_proxy(void *opaque);
+    std::vector<pthread_t> m_handles;
+    pthread_cond_t m_start_cond;
+    pthread_cond_t m_done_cond;
+#elif defined(XP_WIN)
+    static DWORD WINAPI worker_proxy(LPVOID opaque);
+    std::vector<HANDLE> m_handles;
+    HANDLE m_start_sem;
+    HANDLE m_done_event;
+#endif
+
+    unsigned m_threads;
+    plugin_lock_t m_lock;
+    bool m_quit;
+
+    // current job, protected by m_lock
+    job_t m_job;
+    void *m_opaque;
+    unsigned m_lines;
+    unsigned m_stripes;
+    unsigned m_next_stripe;
+    unsigned m_pending;
+};
+
+#endif /* __VLCWINDOWLESS_WORKERS_H__ */
@@ -26,16 +26,76 @@
 #include <X11/Xlib-xcb.h>
 #include <xcb/xcb.h>
 #include <xcb/xproto.h>
+#include <xcb/xcbext.h>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
+
+#ifdef HAVE_XCB_SHM
+# include <xcb/shm.h>
+# include <sys/ipc.h>
+# include <sys/shm.h>
+#endif
 
 VlcWindowlessXCB::VlcWindowlessXCB(NPP instance, NPuint16_t mode) :
-    VlcWindowlessBase(instance, mode), m_conn(0), m_colormap(0)
+    VlcWindowlessBase(instance, mode), m_conn(0), m_colormap(0), m_depth(24),
+    m_visual(0), m_shm(0), m_bg_pixel(0), m_bg_colormap(0),
+    m_gc_depth(0), m_bg_gc(0), m_gc(0), m_pixmap(0), m_pixmap_width(0),
+    m_pixmap_height(0), m_pixmap_seq(0), m_pixmap_valid(),
+#ifdef HAVE_XCB_RENDER
+    m_render(false), m_render_format(0), m_src_picture(0),
+    m_src_picture_width(0), m_src_picture_height(0),
+#endif
+    m_upload_pending(false),
+    m_upload_seq(0),
+    m_upload_fence(0)
 {
+    plugin_lock_init(&m_detach_lock);
 }
 
 VlcWindowlessXCB::~VlcWindowlessXCB()
 {
+    /* shared buffers must be detached while our free_frame_buf() is
+     * still reachable */
+    release_frame_pool();
+
+    if (m_conn) {
+        detachSegments();
+        if (m_upload_pending) {
+            xcb_discard_reply(m_conn, m_upload_seq);
+            if (m_upload_fence)
+                xcb_discard_reply(m_conn, m_upload_fence);
+        }
+#ifdef HAVE_XCB_RENDER
+        freePixmap();
+#else
+        if (m_pixmap)
+            xcb_free_pixmap(m_conn, m_pixmap);
+#endif
+        freeGCs();
+        xcb_flush(m_conn);
+    }
+    plugin_lock_destroy(&m_detach_lock);
+}
+
+void VlcWindowlessXCB::setWindow(const NPWindow &window)
+{
+    VlcWindowlessBase::setWindow(window);
+
+    /* connect early so the frame buffers can be shared with the server */
+    if (!m_conn) {
+        initXCB();
+        return;
+    }
+
+    NPSetWindowCallbackStruct *info =
+            static_cast<NPSetWindowCallbackStruct *>(npwindow.ws_info);
+    if (info) {
+        m_colormap = info->colormap;
+        m_visual = info->visual;
+        if (info->depth)
+            m_depth = info->depth;
+    }
 }
 
 bool VlcWindowlessXCB::initXCB()
@@ -50,37 +110,430 @@ bool VlcWindowlessXCB::initXCB()
 
     m_conn = XGetXCBConnection(info->display);
     m_colormap = info->colormap;
+    m_visual = info->visual;
+    if (info->depth)
+        m_depth = info->depth;
+
+#ifdef HAVE_XCB_SHM
+    /* the segments themselves are validated in attachFrame() since
+     * remote servers may advertise the extension without being able to
+     * attach our memory */
+    const xcb_query_extension_reply_t *ext =
+            xcb_get_extension_data(m_conn, &xcb_shm_id);
+    plugin_atomic_swap(&m_shm, ext && ext->present);
+#endif
+#ifdef HAVE_XCB_RENDER
+    m_render = initRender();
+#endif
 
     return true;
 }
 
-void VlcWindowlessXCB::drawBackground(xcb_drawable_t drawable)
+#ifdef HAVE_XCB_RENDER
+bool VlcWindowlessXCB::initRender()
 {
-    /* Obtain the background color */
-    unsigned r = 0, g = 0, b = 0;
-    HTMLColor2RGB(get_options().get_bg_color().c_str(), &r, &g, &b);
-    xcb_alloc_color_reply_t *reply = xcb_alloc_color_reply(m_conn,
-            xcb_alloc_color(m_conn, m_colormap,
-                            (uint16_t) r << 8,
-                            (uint16_t) g << 8,
-                            (uint16_t) b << 8), NULL);
-    uint32_t colorpixel = reply->pixel;
+    const xcb_query_extension_reply_t *ext =
+            xcb_get_extension_data(m_conn, &xcb_render_id);
+    if (!ext || !ext->present || !m_visual)
+        return false;
+
+    /* find the picture format of our visual, once */
+    xcb_visualid_t visual = XVisualIDFromVisual(m_visual);
+    xcb_render_query_pict_formats_reply_t *reply =
+            xcb_render_query_pict_formats_reply(m_conn,
+                    xcb_render_query_pict_formats(m_conn), NULL);
+    if (!reply)
+        return false;
+
+    m_render_format = 0;
+    xcb_render_pictscreen_iterator_t screens =
+            xcb_render_query_pict_formats_screens_iterator(reply);
+    for (; screens.rem && !m_render_format; xcb_render_pictscreen_next(&screens)) {
+        xcb_render_pictdepth_iterator_t depths =
+                xcb_render_pictscreen_depths_iterator(screens.data);
+        for (; depths.rem && !m_render_format; xcb_render_pictdepth_next(&depths)) {
+            if (depths.data->depth != m_depth)
+                continue;
+            xcb_render_pictvisual_iterator_t visuals =
+                    xcb_render_pictdepth_visuals_iterator(depths.data);
+            for (; visuals.rem; xcb_render_pictvisual_next(&visuals)) {
+                if (visuals.data->visual == visual) {
+                    m_render_format = visuals.data->format;
+                    break;
+                }
+            }
+        }
+    }
     free(reply);
 
-    /* Prepare to fill the background */
-    xcb_gcontext_t background = xcb_generate_id(m_conn);
-    uint32_t        mask       = XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES;
-    uint32_t        values[2]  = {colorpixel, 0};
-    xcb_create_gc(m_conn, background, drawable, mask, values);
-    xcb_rectangle_t rect;
-    rect.x = npwindow.x;
-    rect.y = npwindow.y;
-    rect.width = npwindow.width;
-    rect.height = npwindow.height;
+    return m_render_format != 0;
+}
+
+void VlcWindowlessXCB::freePixmap()
+{
+    if (m_src_picture)
+        xcb_render_free_picture(m_conn, m_src_picture);
+    m_src_picture = 0;
+    if (m_pixmap)
+        xcb_free_pixmap(m_conn, m_pixmap);
+    m_pixmap = 0;
+}
+
+void VlcWindowlessXCB::compositeFrame(xcb_drawable_t drawable,
+                                      const xcb_rectangle_t &damage,
+                                      int left, int top,
+                                      unsigned width, unsigned height)
+{
+    if (!m_src_picture) {
+        /* pad: the filter reads past the edges, which would otherwise
+         * blend the border with transparent pixels */
+        uint32_t repeat = XCB_RENDER_REPEAT_PAD;
+        m_src_picture = xcb_generate_id(m_conn);
+        xcb_render_create_picture(m_conn, m_src_picture, m_pixmap,
+                                  m_render_format, XCB_RENDER_CP_REPEAT,
+                                  &repeat);
+        static const char filter[] = "bilinear";
+        xcb_render_set_picture_filter(m_conn, m_src_picture,
+                                      sizeof(filter) - 1, filter, 0, NULL);
+        m_src_picture_width = m_src_picture_height = 0;
+    }
+
+    if (m_src_picture_width != width || m_src_picture_height != height) {
+        /* maps destination to source coordinates, 16.16 fixed point */
+        xcb_render_transform_t transform = {
+            (xcb_render_fixed_t)(((int64_t)m_pixmap_width << 16) / width), 0, 0,
+            0, (xcb_render_fixed_t)(((int64_t)m_pixmap_height << 16) / height), 0,
+            0, 0, 1 << 16
+        };
+        xcb_render_set_picture_transform(m_conn, m_src_picture, transform);
+        m_src_picture_width = width;
+        m_src_picture_height = height;
+    }
+
+    /* the drawable given by the browser may change between exposes */
+    xcb_render_picture_t dst = xcb_generate_id(m_conn);
+    xcb_render_create_picture(m_conn, dst, drawable, m_render_format, 0, NULL);
+    xcb_render_composite(m_conn, XCB_RENDER_PICT_OP_SRC,
+                         m_src_picture, XCB_RENDER_PICTURE_NONE, dst,
+                         damage.x, damage.y, 0, 0,
+                         left + damage.x, top + damage.y,
+                         damage.width, damage.height);
+    xcb_render_free_picture(m_conn, dst);
+}
+#endif
+
+bool VlcWindowlessXCB::scales_on_present()
+{
+#ifdef HAVE_XCB_RENDER
+    return m_render;
+#else
+    return false;
+#endif
+}
+
+bool VlcWindowlessXCB::alloc_frame_buf(FrameBuffer &fb, size_t size)
+{
+    fb.shmid = -1;
+    fb.shmseg = 0;
+#ifdef HAVE_XCB_SHM
+    /* planar frames are converted on our side, the server never sees
+     * them. The segment is attached by the browser thread, when the
+     * frame is first painted. */
+    if (plugin_atomic_get(&m_shm) && !fb.planar) {
+        int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+        if (id != -1) {
+            void *addr = shmat(id, NULL, 0);
+            if (addr != (void *)-1) {
+                fb.alloc = addr;
+                fb.data = static_cast<char *>(addr);
+                fb.size = size;
+                fb.shmid = id;
+                return true;
+            }
+            shmctl(id, IPC_RMID, NULL);
+        }
+    }
+#endif
+    return VlcWindowlessBase::alloc_frame_buf(fb, size);
+}
+
+void VlcWindowlessXCB::free_frame_buf(FrameBuffer &fb)
+{
+#ifdef HAVE_XCB_SHM
+    if (fb.shmid != -1) {
+        /* the server is done with the pixels (see handle_event()), the
+         * segment lives on until it is detached there too */
+        if (fb.shmseg) {
+            plugin_lock(&m_detach_lock);
+            m_detach.push_back(fb.shmseg);
+            plugin_unlock(&m_detach_lock);
+        }
+        else
+            shmctl(fb.shmid, IPC_RMID, NULL);
+        shmdt(fb.alloc);
+        fb.shmid = -1;
+        fb.shmseg = 0;
+        fb.alloc = 0;
+        fb.data = 0;
+        fb.size = 0;
+        return;
+    }
+#endif
+    VlcWindowlessBase::free_frame_buf(fb);
+}
+
+/* browser thread, the frame being painted */
+bool VlcWindowlessXCB::attachFrame(FrameBuffer *fb)
+{
+#ifdef HAVE_XCB_SHM
+    if (fb->shmseg)
+        return true;
+    if (fb->shmid == -1 || !plugin_atomic_get(&m_shm))
+        return false;
+
+    /* once per buffer */
+    xcb_shm_seg_t seg = xcb_generate_id(m_conn);
+    xcb_generic_error_t *err = xcb_request_check(m_conn,
+            xcb_shm_attach_checked(m_conn, seg, fb->shmid, 1));
+    /* destroyed automatically once both sides have detached */
+    shmctl(fb->shmid, IPC_RMID, NULL);
+    if (!err) {
+        fb->shmseg = seg;
+        return true;
+    }
+    free(err);
+    /* the pixels are still ours, they go through xcb_put_image */
+    fprintf(stderr, "MIT-SHM unavailable, falling back to xcb_put_image\n");
+    plugin_atomic_swap(&m_shm, 0);
+#endif
+    return false;
+}
+
+/* browser thread */
+void VlcWindowlessXCB::detachSegments()
+{
+#ifdef HAVE_XCB_SHM
+    plugin_lock(&m_detach_lock);
+    for (size_t i = 0; i < m_detach.size(); ++i)
+        xcb_shm_detach(m_conn, m_detach[i]);
+    m_detach.clear();
+    plugin_unlock(&m_detach_lock);
+#endif
+}
+
+uint32_t VlcWindowlessXCB::backgroundPixel()
+{
+    const std::string &bg_color = get_options().get_bg_color();
+    if (m_bg_colormap == m_colormap && m_bg_color == bg_color)
+        return m_bg_pixel;
+
+    unsigned r = 0, g = 0, b = 0;
+    HTMLColor2RGB(bg_color.c_str(), &r, &g, &b);
+
+    if (m_visual && m_visual->c_class == TrueColor) {
+        /* no need to ask the server, the pixel is made of the masks */
+        unsigned long rgb[3] = { r, g, b };
+        unsigned long masks[3] = { m_visual->red_mask,
+                                   m_visual->green_mask,
+                                   m_visual->blue_mask };
+        m_bg_pixel = 0;
+        for (int i = 0; i < 3; ++i) {
+            unsigned long mask = masks[i];
+            if (!mask)
+                continue;
+            int shift = 0;
+            while (!((mask >> shift) & 1))
+                ++shift;
+            unsigned long max = mask >> shift;
+            m_bg_pixel |= ((rgb[i] * max + 127) / 255) << shift;
+        }
+    } else {
+        /* only once per colormap/color */
+        xcb_alloc_color_reply_t *reply = xcb_alloc_color_reply(m_conn,
+                xcb_alloc_color(m_conn, m_colormap,
+                                (uint16_t) r << 8,
+                                (uint16_t) g << 8,
+                                (uint16_t) b << 8), NULL);
+        m_bg_pixel = reply ? reply->pixel : 0;
+        free(reply);
+    }
+
+    m_bg_color = bg_color;
+    m_bg_colormap = m_colormap;
+    if (m_bg_gc)
+        xcb_change_gc(m_conn, m_bg_gc, XCB_GC_FOREGROUND, &m_bg_pixel);
+
+    return m_bg_pixel;
+}
+
+void VlcWindowlessXCB::prepareGCs(xcb_drawable_t drawable)
+{
+    /* GCs are usable on any drawable of the same screen and depth */
+    if (m_gc && m_gc_depth == m_depth)
+        return;
+
+    freeGCs();
+#ifdef HAVE_XCB_RENDER
+    freePixmap();
+#else
+    if (m_pixmap) {
+        xcb_free_pixmap(m_conn, m_pixmap);
+        m_pixmap = 0;
+    }
+#endif
+
+    uint32_t mask      = XCB_GC_FOREGROUND | XCB_GC_GRAPHICS_EXPOSURES;
+    uint32_t values[2] = {backgroundPixel(), 0};
+    m_bg_gc = xcb_generate_id(m_conn);
+    xcb_create_gc(m_conn, m_bg_gc, drawable, mask, values);
+
+    mask = XCB_GC_GRAPHICS_EXPOSURES;
+    m_gc = xcb_generate_id(m_conn);
+    xcb_create_gc(m_conn, m_gc, drawable, mask, &values[1]);
+
+    m_gc_depth = m_depth;
+}
+
+void VlcWindowlessXCB::freeGCs()
+{
+    if (m_bg_gc)
+        xcb_free_gc(m_conn, m_bg_gc);
+    if (m_gc)
+        xcb_free_gc(m_conn, m_gc);
+    m_bg_gc = m_gc = 0;
+}
+
+/* Clip r to clip, returns false if nothing is left */
+static bool intersectRect(xcb_rectangle_t &r, const xcb_rectangle_t &clip)
+{
+    int x1 = std::max<int>(r.x, clip.x);
+    int y1 = std::max<int>(r.y, clip.y);
+    int x2 = std::min<int>(r.x + r.width,  clip.x + clip.width);
+    int y2 = std::min<int>(r.y + r.height, clip.y + clip.height);
+    if (x2 <= x1 || y2 <= y1)
+        return false;
+
+    r.x = x1;
+    r.y = y1;
+    r.width = x2 - x1;
+    r.height = y2 - y1;
+    return true;
+}
+
+static xcb_rectangle_t makeRect(int x, int y, int width, int height)
+{
+    xcb_rectangle_t r;
+    r.x = x;
+    r.y = y;
+    r.width = width > 0 ? width : 0;
+    r.height = height > 0 ? height : 0;
+    return r;
+}
+
+void VlcWindowlessXCB::drawBackground(xcb_drawable_t drawable,
+                                      const xcb_rectangle_t &video,
+                                      const xcb_rectangle_t &area)
+{
+    /* Keep the cached GC in sync with the background color */
+    backgroundPixel();
+
+    int wx = npwindow.x, wy = npwindow.y;
+    int ww = npwindow.width, wh = npwindow.height;
+
+    /* Only the letterbox bars around the video need to be filled */
+    xcb_rectangle_t bars[4];
+    int count = 0;
+    if (!video.width || !video.height) {
+        bars[count++] = makeRect(wx, wy, ww, wh);
+    } else {
+        bars[count++] = makeRect(wx, wy, ww, video.y - wy);
+        bars[count++] = makeRect(wx, video.y + video.height,
+                                 ww, wy + wh - video.y - video.height);
+        bars[count++] = makeRect(wx, video.y, video.x - wx, video.height);
+        bars[count++] = makeRect(video.x + video.width, video.y,
+                                 wx + ww - video.x - video.width, video.height);
+    }
+
+    int n = 0;
+    for (int i = 0; i < count; ++i)
+        if (intersectRect(bars[i], area))
+            bars[n++] = bars[i];
 
     /* Fill the background */
-    xcb_poly_fill_rectangle(m_conn, drawable, background, 1, &rect);
-    xcb_free_gc(m_conn, background);
+    if (n)
+        xcb_poly_fill_rectangle(m_conn, drawable, m_bg_gc, n, bars);
+}
+
+void VlcWindowlessXCB::checkUpload()
+{
+    if (!m_upload_pending)
+        return;
+
+    /* PutImage has no reply: its error is only known once the reply of
+     * the fence queued after it came back, never wait for it */
+    void *reply = NULL;
+    xcb_generic_error_t *err = NULL;
+    if (m_upload_fence) {
+        if (!xcb_poll_for_reply(m_conn, m_upload_fence, &reply, &err))
+            return;
+        free(reply);
+        free(err);
+        m_upload_fence = 0;
+        reply = NULL;
+        err = NULL;
+    }
+    if (!xcb_poll_for_reply(m_conn, m_upload_seq, &reply, &err))
+        return;
+
+    m_upload_pending = false;
+    free(reply);
+    if (err) {
+        fprintf(stderr, "Unable to put picture into pixmap. Error %d\n",
+                        err->error_code);
+        free(err);
+        /* force a new upload on the next expose */
+        m_pixmap_seq = 0;
+        m_pixmap_valid.width = m_pixmap_valid.height = 0;
+    }
+}
+
+xcb_void_cookie_t VlcWindowlessXCB::uploadFrame(const FrameBuffer *frame,
+                                                const xcb_rectangle_t &src,
+                                                xcb_drawable_t drawable,
+                                                xcb_gcontext_t gc)
+{
+#ifdef HAVE_XCB_SHM
+    if (frame->shmseg) {
+        xcb_void_cookie_t cookie = xcb_shm_put_image_checked(
+                    m_conn,
+                    drawable,
+                    gc,
+                    frame->pitch / DEF_PIXEL_BYTES,
+                    frame->height,
+                    src.x, src.y,
+                    src.width,
+                    src.height,
+                    src.x, src.y,
+                    m_depth,
+                    XCB_IMAGE_FORMAT_Z_PIXMAP,
+                    0,
+                    frame->shmseg,
+                    0);
+        return cookie;
+    }
+#endif
+    /* PutImage has no source offset: send the band of full rows */
+    return xcb_put_image_checked(
+                m_conn,
+                XCB_IMAGE_FORMAT_Z_PIXMAP,
+                drawable,
+                gc,
+                frame->pitch / DEF_PIXEL_BYTES,
+                src.height,
+                0, src.y,
+                0, m_depth,
+                frame->pitch * src.height,
+                (const uint8_t *)frame->data + frame->pitch * src.y);
 }
 
 bool VlcWindowlessXCB::handle_event(void *event)
@@ -89,52 +542,152 @@ bool VlcWindowlessXCB::handle_event(void *event)
     switch (xevent->type) {
     case GraphicsExpose:
 
-        xcb_gcontext_t gc;
-        xcb_void_cookie_t cookie;
-        xcb_generic_error_t *err;
         XGraphicsExposeEvent *xgeevent = reinterpret_cast<XGraphicsExposeEvent *>(xevent);
 
         /* Initialize xcb connection if necessary */
         if (!m_conn)
             if (!initXCB()) break;
 
-        drawBackground(xgeevent->drawable);
+        detachSegments();
+        prepareGCs(xgeevent->drawable);
+        checkUpload();
 
-        /* Validate video buffer size */
-        if (m_frame_buf.empty() ||
-            m_frame_buf.size() < m_media_width * m_media_height * DEF_PIXEL_BYTES)
+        xcb_rectangle_t area = makeRect(xgeevent->x, xgeevent->y,
+                                        xgeevent->width, xgeevent->height);
+
+        /* Get the newest decoded frame */
+        const FrameBuffer *frame = begin_frame_paint();
+        if (!frame) {
+            end_frame_paint();
+            drawBackground(xgeevent->drawable, makeRect(0, 0, 0, 0), area);
+            xcb_flush(m_conn);
             break;
+        }
 
-        /* Compute the position of the video */
-        int left = npwindow.x + (npwindow.width  - m_media_width)  / 2;
-        int top  = npwindow.y + (npwindow.height - m_media_height) / 2;
+        /* Compute the position and size of the video, XRender scales
+         * the frame to the window on the server side */
+        unsigned width = frame->width, height = frame->height;
+        unsigned out_width = width, out_height = height;
+        if (scales_on_present())
+            fit_size(&out_width, &out_height, npwindow.width, npwindow.height);
+        int left = npwindow.x + (npwindow.width  - out_width)  / 2;
+        int top  = npwindow.y + (npwindow.height - out_height) / 2;
+        xcb_rectangle_t video = makeRect(left, top, out_width, out_height);
 
-        gc = xcb_generate_id(m_conn);
-        xcb_create_gc(m_conn, gc, xgeevent->drawable, 0, NULL);
+        drawBackground(xgeevent->drawable, video, area);
 
-        /* Push the frame in X11 */
-        cookie = xcb_put_image_checked(
-                    m_conn,
-                    XCB_IMAGE_FORMAT_Z_PIXMAP,
-                    xgeevent->drawable,
-                    gc,
-                    m_media_width,
-                    m_media_height,
-                    left, top,
-                    0, 24,
-                    m_media_width * m_media_height * 4,
-                    (const uint8_t *)&m_frame_buf[0]);
-
-        if (err = xcb_request_check(m_conn, cookie))
+        /* Part of the video damaged by this expose, in video coordinates */
+        xcb_rectangle_t damage = video;
+        if (!intersectRect(damage, area)) {
+            end_frame_paint();
+            xcb_flush(m_conn);
+            break;
+        }
+        damage.x -= left;
+        damage.y -= top;
+
+        /* Same in frame coordinates, with a margin for the filter */
+        xcb_rectangle_t src_damage = damage;
+        if (out_width != width || out_height != height) {
+            int x1 = (int64_t)damage.x * width / out_width - 1;
+            int y1 = (int64_t)damage.y * height / out_height - 1;
+            int x2 = ((int64_t)(damage.x + damage.width) * width + out_width - 1)
+                        / out_width + 1;
+            int y2 = ((int64_t)(damage.y + damage.height) * height + out_height - 1)
+                        / out_height + 1;
+            src_damage = makeRect(x1, y1, x2 - x1, y2 - y1);
+            intersectRect(src_damage, makeRect(0, 0, width, height));
+        }
+
+        /* Upload the frame to the server side cache only when libvlc
+         * displayed a new one, a plain expose is a copy on the server */
+        if (m_pixmap && (m_pixmap_width != width ||
+                         m_pixmap_height != height)) {
+#ifdef HAVE_XCB_RENDER
+            freePixmap();
+#else
+            xcb_free_pixmap(m_conn, m_pixmap);
+            m_pixmap = 0;
+#endif
+        }
+        if (!m_pixmap) {
+            m_pixmap = xcb_generate_id(m_conn);
+            xcb_create_pixmap(m_conn, m_depth, m_pixmap,
+                              xgeevent->drawable, width, height);
+            m_pixmap_width = width;
+            m_pixmap_height = height;
+            m_pixmap_seq = 0;
+        }
+        if (m_pixmap_seq != frame->seq) {
+            m_pixmap_seq = frame->seq;
+            m_pixmap_valid = makeRect(0, 0, 0, 0);
+        }
+
+        /* Only the damaged part of a new frame is sent, the pixmap keeps
+         * track of what it holds for the next exposes */
+        bool fenced = false;
+        xcb_get_input_focus_cookie_t fence = { 0 };
+        xcb_rectangle_t valid = src_damage;
+        if (!intersectRect(valid, m_pixmap_valid) ||
+            valid.x != src_damage.x || valid.y != src_damage.y ||
+            valid.width != src_damage.width || valid.height != src_damage.height)
         {
-            fprintf(stderr, "Unable to put picture into drawable. Error %d\n",
-                            err->error_code);
-            free(err);
+            xcb_rectangle_t upload = src_damage;
+            if (m_pixmap_valid.width && m_pixmap_valid.height) {
+                /* keep a single valid rectangle: their bounding box */
+                int x2 = std::max(upload.x + upload.width,
+                                  m_pixmap_valid.x + m_pixmap_valid.width);
+                int y2 = std::max(upload.y + upload.height,
+                                  m_pixmap_valid.y + m_pixmap_valid.height);
+                upload.x = std::min(upload.x, m_pixmap_valid.x);
+                upload.y = std::min(upload.y, m_pixmap_valid.y);
+                upload.width = x2 - upload.x;
+                upload.height = y2 - upload.y;
+            }
+            bool shm = attachFrame(const_cast<FrameBuffer *>(frame));
+            if (!shm) {
+                upload.x = 0;
+                upload.width = width;
+            }
+
+            /* errors are collected by checkUpload() on a later expose,
+             * once the reply of the fence came back */
+            if (m_upload_pending) {
+                xcb_discard_reply(m_conn, m_upload_seq);
+                if (m_upload_fence)
+                    xcb_discard_reply(m_conn, m_upload_fence);
+            }
+            m_upload_seq = uploadFrame(frame, upload, m_pixmap, m_gc).sequence;
+            fence = xcb_get_input_focus(m_conn);
+            m_upload_fence = fence.sequence;
+            m_upload_pending = true;
+            m_pixmap_valid = upload;
+
+            /* the server reads shared pixels asynchronously: the fence
+             * tells the frame may go back to libvlc */
+            fenced = shm;
         }
 
+        /* Push the damaged part of the frame in X11 */
+#ifdef HAVE_XCB_RENDER
+        if (out_width != width || out_height != height)
+            compositeFrame(xgeevent->drawable, damage,
+                           left, top, out_width, out_height);
+        else
+#endif
+        xcb_copy_area(m_conn, m_pixmap, xgeevent->drawable, m_gc,
+                      damage.x, damage.y, left + damage.x, top + damage.y,
+                      damage.width, damage.height);
+
         /* Flush the the connection */
         xcb_flush(m_conn);
-        xcb_free_gc(m_conn, gc);
+
+        if (fenced) {
+            free(xcb_get_input_focus_reply(m_conn, fence, NULL));
+            m_upload_fence = 0;
+            checkUpload();
+        }
+        end_frame_paint();
     }
     return VlcWindowlessBase::handle_event(event);
 }
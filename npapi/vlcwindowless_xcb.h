@@ -26,7 +26,11 @@
 
 #include "vlcwindowless_base.h"
 
+#include <vector>
 #include <xcb/xcb.h>
+#ifdef HAVE_XCB_RENDER
+# include <xcb/render.h>
+#endif
 
 class VlcWindowlessXCB : public VlcWindowlessBase
 {
@@ -35,14 +39,76 @@ public:
     virtual ~VlcWindowlessXCB();
 
     bool handle_event(void *event);
+    void setWindow(const NPWindow &window);
 
 protected:
     bool initXCB();
-    void drawBackground(xcb_drawable_t drawable);
+    void drawBackground(xcb_drawable_t drawable, const xcb_rectangle_t &video,
+                        const xcb_rectangle_t &area);
+    uint32_t backgroundPixel();
+    void prepareGCs(xcb_drawable_t drawable);
+    void freeGCs();
+    void checkUpload();
+    bool attachFrame(FrameBuffer *fb);
+    void detachSegments();
+
+    // called from the libvlc video thread: no X requests in there, the
+    // connection belongs to the browser's Xlib
+    bool alloc_frame_buf(FrameBuffer &fb, size_t size);
+    void free_frame_buf(FrameBuffer &fb);
+    bool scales_on_present();
+
+    xcb_void_cookie_t uploadFrame(const FrameBuffer *frame,
+                                  const xcb_rectangle_t &src,
+                                  xcb_drawable_t drawable, xcb_gcontext_t gc);
+
+#ifdef HAVE_XCB_RENDER
+    bool initRender();
+    void freePixmap();
+    void compositeFrame(xcb_drawable_t drawable, const xcb_rectangle_t &damage,
+                        int left, int top, unsigned width, unsigned height);
+#endif
 
 private:
     xcb_connection_t *m_conn;
     xcb_colormap_t m_colormap;
+    uint8_t m_depth;
+    Visual *m_visual;
+    // MIT-SHM is usable (local server with the extension), read by the
+    // video thread
+    plugin_atomic_t m_shm;
+    // segments of freed buffers, detached by the browser thread
+    plugin_lock_t m_detach_lock;
+    std::vector<uint32_t> m_detach;
+
+    // resolved once per colormap/color, no round trip when painting
+    uint32_t m_bg_pixel;
+    std::string m_bg_color;
+    xcb_colormap_t m_bg_colormap;
+    uint8_t m_gc_depth;
+    xcb_gcontext_t m_bg_gc;
+    xcb_gcontext_t m_gc;
+
+    // last presented frame, kept on the server for plain exposes
+    xcb_pixmap_t m_pixmap;
+    unsigned m_pixmap_width;
+    unsigned m_pixmap_height;
+    unsigned m_pixmap_seq;
+    xcb_rectangle_t m_pixmap_valid; // part of frame m_pixmap_seq uploaded
+
+#ifdef HAVE_XCB_RENDER
+    // XRender scales the cached pixmap to the window size
+    bool m_render;
+    xcb_render_pictformat_t m_render_format;
+    xcb_render_picture_t m_src_picture;
+    unsigned m_src_picture_width;   // scaled size of m_src_picture
+    unsigned m_src_picture_height;
+#endif
+
+    // last upload, its error (if any) is collected asynchronously
+    bool m_upload_pending;
+    unsigned m_upload_seq;
+    unsigned m_upload_fence; // GetInputFocus queued after it, 0 once received
 };
 
 
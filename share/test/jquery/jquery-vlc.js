@@ -524,14 +524,16 @@ if (typeof(VLC_STATUS)=='undefined') {
                    
                         var plugin = this.__getPlugin();
                         if (!plugin.input) return;
-                         var status = plugin.input.state;
+                         // one call into the plugin when it has snapshot()
+                         var input = plugin.input.snapshot ? plugin.input.snapshot() : plugin.input;
+                         var status = input.state;
                             if (status != this.status) {
                                  this.status = status;
                                  this.statusChanged();
                             }
                         if (plugin.playlist.isPlaying) {
                              
-                            this.updatePosition(plugin.input.time / 1000, plugin.input.length / 1000)
+                            this.updatePosition(input.time / 1000, input.length / 1000)
                 
                             }
                            